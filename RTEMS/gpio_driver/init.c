@@ -1,6 +1,14 @@
 /*
  * RPi GPIO test example
- * blink ACT led (GPIO 16) + receive input from GPIO 24
+ * blink ACT led (GPIO 16) + receive input edges from GPIO 24
+ *
+ * The output is toggled by the same workload from three timing
+ * back-ends, one after the other: a POSIX timer signal, an RTEMS
+ * timer-server routine and a rate-monotonic task. The activation
+ * jitter of each back-end is measured with the BCM2835 system timer
+ * and printed side by side at the end.
+ *
+ * Input edges are echoed on GPIO 23 through the driver GPIO server.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,57 +17,109 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <time.h>
+#include <pthread.h>
+#include <rtems.h>
+#include <bsp.h>
 
 #include "rpi_gpio.h"
+#include "rpi_spi.h"
 
 int fd;
-int gpio_input;
 
 #define G_IN    24
 #define G_OUT   25
+#define G_ECHO  23      // input level, through the GPIO server
 
-void got_signal (int sig)
+#define PERIOD_MS       10
+#define SAMPLES         1000  // activations per back-end
+
+#define ST_CLO (*(volatile unsigned int *)BCM2835_GPU_TIMER_CLO) // system timer, 1 MHz
+
+enum { MODE_SIGNAL, MODE_TIMER_SERVER, MODE_RATE_MONOTONIC, NMODES };
+
+// Activation jitter: interval between activations minus the period
+struct jitter {
+  const char *name;
+  uint32_t n;
+  uint32_t last;
+  int32_t min, max;
+  int64_t sum_abs;
+};
+
+static struct jitter jit[NMODES] = {
+  { "signal" }, { "timer server" }, { "rate monotonic" }
+};
+
+static volatile int done;
+
+#ifdef SPI_BENCH
+void spi_benchmark (void);
+#endif
+
+// GPIO workload, the same for every back-end
+static void gpio_work (void)
 {
   static int n = 0;
-  int status, input;
+  int status;
 
   if (n % 2 == 0)
     status = ioctl (fd, RPI_GPIO_SET, G_OUT);
   else
     status = ioctl (fd, RPI_GPIO_CLR, G_OUT);
 
-  if ((input = ioctl (fd, RPI_GPIO_READ, G_IN)) != gpio_input) {
-    printf ("input= %d\n", ioctl (fd, RPI_GPIO_READ, G_IN));
-    gpio_input = input;
-  }
-
   n++;
 
   if (status)
     fprintf (stderr, "status= %d errno= %d => %s\n", status, errno, strerror(errno));
 }
 
-void *POSIX_Init() 
+// Called first thing at each activation, whatever the back-end
+static void activation (struct jitter *j)
 {
-  timer_t myTimer;
-  struct sigaction sig;
-  struct itimerspec ti, ti_old;
-  struct sigevent event;
-  sigset_t mask;
-
-  puts( "\n\n*** RPi GPIO driver test ***" );
+  uint32_t now = ST_CLO;
+  int32_t d;
 
-  if ((fd = open ("/dev/rpi_gpio", O_RDWR)) < 0) {
-    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
-    exit (1);
+  if (j->n) {
+    d = (int32_t)(now - j->last) - PERIOD_MS * 1000;
+    if (j->n == 1 || d < j->min)
+      j->min = d;
+    if (j->n == 1 || d > j->max)
+      j->max = d;
+    j->sum_abs += (d < 0 ? -d : d);
   }
 
-  printf ("fd = %d\n", fd);
+  j->last = now;
+  j->n++;
 
-  ioctl(fd, RPI_GPIO_IN, G_IN);
-  ioctl(fd, RPI_GPIO_OUT, G_OUT);
+  gpio_work ();
+
+  if (j->n > SAMPLES)
+    done = 1;
+}
+
+static void wait_done (void)
+{
+  // nanosleep() lets SIGALRM in
+  while (!done)
+    usleep (100000);
+}
 
-  gpio_input = ioctl (fd, RPI_GPIO_READ, G_IN);
+//
+// 1- POSIX timer + signal
+//
+void got_signal (int sig)
+{
+  if (!done)
+    activation (&jit[MODE_SIGNAL]);
+}
+
+static void run_signal (void)
+{
+  timer_t myTimer;
+  struct sigaction sig;
+  struct itimerspec ti, ti_old;
+  struct sigevent event;
+  sigset_t mask;
 
   // Set up signal
   sig.sa_flags = 0;
@@ -80,10 +140,188 @@ void *POSIX_Init()
   ti.it_value.tv_sec = 0;
   ti.it_value.tv_nsec = 5000000;
   ti.it_interval.tv_sec = 0;
-  ti.it_interval.tv_nsec = 10000000;
+  ti.it_interval.tv_nsec = PERIOD_MS * 1000000;
 
   timer_settime(myTimer, 0, &ti, &ti_old);
 
+  wait_done ();
+
+  timer_delete (myTimer);
+}
+
+//
+// 2- RTEMS timer server
+//
+static rtems_interval period_ticks;
+
+static rtems_timer_service_routine timer_routine (rtems_id id, void *arg)
+{
+  if (done)
+    return;
+
+  // re-arm first so the routine run time does not add up
+  rtems_timer_server_fire_after (id, period_ticks, timer_routine, NULL);
+  activation (&jit[MODE_TIMER_SERVER]);
+}
+
+static void run_timer_server (void)
+{
+  rtems_status_code status;
+  rtems_id timer;
+
+  status = rtems_timer_initiate_server (1, RTEMS_MINIMUM_STACK_SIZE * 2, RTEMS_DEFAULT_ATTRIBUTES);
+  if (status == RTEMS_SUCCESSFUL)
+    status = rtems_timer_create (rtems_build_name ('J', 'T', 'M', 'R'), &timer);
+  if (status == RTEMS_SUCCESSFUL)
+    status = rtems_timer_server_fire_after (timer, period_ticks, timer_routine, NULL);
+  if (status != RTEMS_SUCCESSFUL) {
+    fprintf (stderr, "timer server failed with status: %d\n", status);
+    return;
+  }
+
+  wait_done ();
+
+  rtems_timer_cancel (timer);
+}
+
+//
+// 3- Rate monotonic task
+//
+static rtems_task rm_task (rtems_task_argument unused)
+{
+  rtems_status_code status;
+  rtems_id RM_period;
+
+  status = rtems_rate_monotonic_create (rtems_build_name ('P', 'E', 'R', '1'), &RM_period);
+  if (status != RTEMS_SUCCESSFUL) {
+    fprintf (stderr, "RM failed with status: %d\n", status);
+    done = 1;
+    rtems_task_delete (RTEMS_SELF);
+  }
+
+  while (!done) {
+    rtems_rate_monotonic_period (RM_period, period_ticks);
+    activation (&jit[MODE_RATE_MONOTONIC]);
+  }
+
+  rtems_rate_monotonic_delete (RM_period);
+  rtems_task_delete (RTEMS_SELF);
+}
+
+static void run_rate_monotonic (void)
+{
+  rtems_status_code status;
+  rtems_id tid;
+
+  status = rtems_task_create (rtems_build_name ('J', 'R', 'M', ' '), 1, RTEMS_MINIMUM_STACK_SIZE * 2,
+			      RTEMS_DEFAULT_MODES, RTEMS_DEFAULT_ATTRIBUTES, &tid);
+  if (status == RTEMS_SUCCESSFUL)
+    status = rtems_task_start (tid, rm_task, 0);
+  if (status != RTEMS_SUCCESSFUL) {
+    fprintf (stderr, "RM task failed with status: %d\n", status);
+    return;
+  }
+
+  wait_done ();
+}
+
+// Input edges come from the driver ISR, no polling
+void *input_thread (void *arg)
+{
+  rpi_gpio_event_t ev[8];
+  rpi_gpio_req_t req;
+  sigset_t mask;
+  ssize_t n;
+  int i;
+
+  // SIGALRM must go to POSIX_Init, not to this (blocked) thread
+  sigemptyset (&mask);
+  sigaddset (&mask, SIGALRM);
+  pthread_sigmask (SIG_BLOCK, &mask, NULL);
+
+  while (1) {
+    if ((n = read (fd, ev, sizeof (ev))) < 0) {
+      fprintf (stderr, "read error => %d %s\n", errno, strerror(errno));
+      continue;
+    }
+
+    for (i = 0; i < n / (ssize_t)sizeof (rpi_gpio_event_t); i++) {
+      req.set = ev[i].level ? 1 << G_ECHO : 0;
+      req.clr = ev[i].level ? 0 : 1 << G_ECHO;
+      ioctl (fd, RPI_GPIO_POST, &req);
+      printf ("input= %d (GPIO %d at %u us)\n", ev[i].level, ev[i].pin, (unsigned)ev[i].timestamp);
+    }
+  }
+}
+
+void *POSIX_Init()
+{
+  pthread_t input_tid;
+  rpi_gpio_edge_t edge;
+  rpi_gpio_server_stats_t st;
+  rtems_status_code status;
+  struct jitter *j;
+  int i;
+
+  puts( "\n\n*** RPi GPIO driver test ***" );
+
+  if ((fd = open ("/dev/rpi_gpio", O_RDWR)) < 0) {
+    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
+    exit (1);
+  }
+
+  printf ("fd = %d\n", fd);
+
+#ifdef SPI_BENCH
+  spi_benchmark ();
+#endif
+
+  ioctl(fd, RPI_GPIO_IN, G_IN);
+  ioctl(fd, RPI_GPIO_OUT, G_OUT);
+  ioctl(fd, RPI_GPIO_OUT, G_ECHO);
+
+  // echo requests are merged as soon as they are posted
+  status = rpi_gpio_server_start (2, 0);
+  if (status != RTEMS_SUCCESSFUL)
+    fprintf (stderr, "GPIO server failed with status: %d\n", status);
+
+  printf ("input= %d\n", ioctl (fd, RPI_GPIO_READ, G_IN));
+
+  // Both edges of G_IN are queued by the driver
+  edge.rising = 1 << G_IN;
+  edge.falling = 1 << G_IN;
+  ioctl (fd, RPI_GPIO_EDGE, &edge);
+
+  pthread_create (&input_tid, NULL, input_thread, NULL);
+
+  period_ticks = rtems_clock_get_ticks_per_second() * PERIOD_MS / 1000;
+
+  printf ("Period %d ms (%d tick(s)), %d activations per back-end\n", PERIOD_MS, (int)period_ticks, SAMPLES);
+
+  // each back-end stops itself once done is set
+  run_signal ();
+  done = 0;
+  run_timer_server ();
+  done = 0;
+  run_rate_monotonic ();
+
+  printf ("\n%-16s %8s %8s %8s\n", "back-end", "min(us)", "max(us)", "avg|dt|");
+  for (i = 0; i < NMODES; i++) {
+    j = &jit[i];
+    if (j->n < 2)
+      printf ("%-16s %8s %8s %8s\n", j->name, "-", "-", "-");
+    else
+      printf ("%-16s %8ld %8ld %8ld\n", j->name, (long)j->min, (long)j->max,
+	      (long)(j->sum_abs / (j->n - 1)));
+  }
+
+  if (status == RTEMS_SUCCESSFUL) {
+    ioctl (fd, RPI_GPIO_SERVER_STATS, &st);
+    printf ("\nGPIO server: %lu request(s), %lu commit(s), max batch %lu, %lu overflow(s)\n",
+	    (unsigned long)st.requests, (unsigned long)st.commits,
+	    (unsigned long)st.max_batch, (unsigned long)st.overflows);
+  }
+
   while (1)
     pause ();
 }
@@ -93,14 +331,30 @@ void *POSIX_Init()
 
 #define CONFIGURE_APPLICATION_NEEDS_CONSOLE_DRIVER
 #define CONFIGURE_APPLICATION_NEEDS_CLOCK_DRIVER
-#define CONFIGURE_APPLICATION_EXTRA_DRIVERS RPI_GPIO_DRIVER_TABLE_ENTRY
+#define CONFIGURE_APPLICATION_EXTRA_DRIVERS RPI_GPIO_DRIVER_TABLE_ENTRY, RPI_SPI_DRIVER_TABLE_ENTRY
+
+#define CONFIGURE_MICROSECONDS_PER_TICK     1000
 
-#define CONFIGURE_LIBIO_MAXIMUM_FILE_DESCRIPTORS 5
+#define CONFIGURE_LIBIO_MAXIMUM_FILE_DESCRIPTORS 6
 
 #define CONFIGURE_MAXIMUM_POSIX_TIMERS          1
-#define CONFIGURE_MAXIMUM_POSIX_THREADS		1
+#define CONFIGURE_MAXIMUM_POSIX_THREADS		2
+
+// Timer server + rate monotonic back-ends + GPIO server
+#define CONFIGURE_MAXIMUM_TASKS             3
+#define CONFIGURE_MAXIMUM_PERIODS           1
+
+// Needed by the rpi_gpio driver (waveform playback) + timer server back-end
+#define CONFIGURE_MAXIMUM_TIMERS            2
+// rpi_gpio waveform + rpi_spi bus lock
+#define CONFIGURE_MAXIMUM_SEMAPHORES        2
+
+// GPIO server request queue
+#define CONFIGURE_MAXIMUM_MESSAGE_QUEUES    1
+#define CONFIGURE_MESSAGE_BUFFER_MEMORY \
+  CONFIGURE_MESSAGE_BUFFERS_FOR_QUEUE(RPI_GPIO_SERVER_DEPTH, sizeof (rpi_gpio_req_t))
 
-#define CONFIGURE_EXTRA_TASK_STACKS         (6 * RTEMS_MINIMUM_STACK_SIZE)
+#define CONFIGURE_EXTRA_TASK_STACKS         (7 * RTEMS_MINIMUM_STACK_SIZE)
 
 #define CONFIGURE_POSIX_INIT_THREAD_TABLE
 
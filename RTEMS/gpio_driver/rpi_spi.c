@@ -0,0 +1,466 @@
+/*
+ * RTEMS SPI0 driver for RPi
+ */
+#include <rtems.h>
+#include <rtems/irq-extension.h>
+#include <bsp.h>
+#include <bsp/irq.h>
+#include <string.h>
+#include "rpi_spi.h"
+#include "rpi_gpio.h"
+
+#define SPI_BASE             (RPI_PERIPHERAL_BASE + 0x204000)
+
+#define SPI_CS   *((volatile uint32_t *)SPI_BASE + 0) // control and status
+#define SPI_FIFO *((volatile uint32_t *)SPI_BASE + 1) // TX and RX FIFOs
+#define SPI_CLK  *((volatile uint32_t *)SPI_BASE + 2) // clock divider
+
+#define CS_CPHA      (1 << 2)
+#define CS_CPOL      (1 << 3)
+#define CS_CLEAR     (3 << 4)   // clear both FIFOs, one shot
+#define CS_TA        (1 << 7)   // transfer active, chip select asserted
+#define CS_DMAEN     (1 << 8)
+#define CS_INTD      (1 << 9)   // interrupt on done
+#define CS_INTR      (1 << 10)  // interrupt on RX FIFO 3/4 full
+#define CS_ADCS      (1 << 11)  // chip select released at the end of a DMA transfer
+#define CS_DONE      (1 << 16)
+#define CS_RXD       (1 << 17)  // RX FIFO not empty
+#define CS_TXD       (1 << 18)  // TX FIFO not full
+
+#define SPI_IRQ              BCM2835_IRQ_ID_SPI
+#define SPI_CORE_HZ          250000000
+#define SPI_INFLIGHT         48   // bytes sent and not read back, RX FIFO is 64
+#define SPI_TIMEOUT_MS       1000
+
+static char initialized;
+static rtems_id spi_lock;
+static rpi_spi_stats_t spi_stats;
+
+// CS, CPOL and CPHA of the next transfers
+static uint32_t spi_mode;
+
+// Message in progress, shared with the interrupt handler
+static const uint8_t *xfer_tx;
+static uint8_t *xfer_rx;
+static uint32_t xfer_len, xfer_txn, xfer_rxn;
+static rtems_id xfer_waiter;
+
+static void spi_drain(void)
+{
+  uint8_t b;
+
+  while (SPI_CS & CS_RXD) {
+    b = SPI_FIFO;
+    if (xfer_rx)
+      xfer_rx[xfer_rxn] = b;
+    xfer_rxn++;
+  }
+}
+
+static void spi_fill(void)
+{
+  while (xfer_txn < xfer_len && xfer_txn - xfer_rxn < SPI_INFLIGHT && (SPI_CS & CS_TXD)) {
+    SPI_FIFO = xfer_tx ? xfer_tx[xfer_txn] : 0;
+    xfer_txn++;
+  }
+}
+
+static void rpi_spi_isr(void *arg)
+{
+  spi_stats.irqs++;
+
+  spi_drain();
+  spi_fill();
+
+  if (xfer_rxn == xfer_len) {
+    // TA is left alone, the chip select may stay asserted for the next message
+    SPI_CS &= ~(CS_INTR | CS_INTD);
+    rtems_event_send(xfer_waiter, RPI_SPI_EVENT);
+  }
+}
+
+static rtems_status_code spi_wait(void)
+{
+  rtems_event_set events;
+  rtems_status_code sc;
+
+  sc = rtems_event_receive(RPI_SPI_EVENT, RTEMS_WAIT | RTEMS_EVENT_ANY,
+			   RTEMS_MILLISECONDS_TO_TICKS(SPI_TIMEOUT_MS), &events);
+
+  if (sc == RTEMS_TIMEOUT) {
+    spi_stats.timeouts++;
+    SPI_CS = spi_mode | CS_CLEAR;
+    // an event sent while giving up must not complete the next transfer
+    rtems_event_receive(RPI_SPI_EVENT, RTEMS_NO_WAIT | RTEMS_EVENT_ANY, 0, &events);
+  }
+
+  return sc;
+}
+
+// One message from the FIFOs, the chip select is asserted on return
+static rtems_status_code spi_fifo_message(const rpi_spi_msg_t *m)
+{
+  xfer_tx = m->tx;
+  xfer_rx = m->rx;
+  xfer_len = m->len;
+  xfer_txn = xfer_rxn = 0;
+  xfer_waiter = rtems_task_self();
+
+  SPI_CS = spi_mode | CS_TA | CS_CLEAR;
+
+  // interrupts are still off, prefill then let the handler go on
+  spi_fill();
+  SPI_CS = spi_mode | CS_TA | CS_INTR | CS_INTD;
+
+  return spi_wait();
+}
+
+#ifdef RPI_SPI_DMA
+//
+// DMA: TX channel feeds the FIFO (first word is DLEN and CS), RX
+// channel empties it and interrupts at the end
+//
+#ifndef RPI_SPI_DMA_TX
+#define RPI_SPI_DMA_TX       4
+#define RPI_SPI_DMA_RX       5
+#endif
+
+// SDRAM as seen from the DMA: 0x40000000 L2 cached alias on RPi 1,
+// 0xC0000000 uncached on RPi 2/3
+#ifndef RPI_SPI_BUS_ALIAS
+#define RPI_SPI_BUS_ALIAS    0x40000000
+#endif
+
+#define DMA_BASE             (RPI_PERIPHERAL_BASE + 0x7000)
+#define DMA_CH(n)            ((volatile uint32_t *)(DMA_BASE + (n) * 0x100))
+#define DMA_ENABLE           *((volatile uint32_t *)(DMA_BASE + 0xff0))
+// irq_dma0-12 of the GPU bank, the BSP has no id for them
+#define DMA_IRQ(n)           (16 + (n))
+
+#define DMA_CS_ACTIVE        (1 << 0)
+#define DMA_CS_END           (1 << 1)
+#define DMA_CS_INT           (1 << 2)
+#define DMA_CS_RESET         (1 << 31)
+
+#define DMA_TI_INTEN         (1 << 0)
+#define DMA_TI_WAIT_RESP     (1 << 3)
+#define DMA_TI_DEST_INC      (1 << 4)
+#define DMA_TI_DEST_DREQ     (1 << 6)
+#define DMA_TI_SRC_INC       (1 << 8)
+#define DMA_TI_SRC_DREQ      (1 << 10)
+#define DMA_TI_PERMAP(p)     ((p) << 16)
+
+#define DREQ_SPI_TX          6
+#define DREQ_SPI_RX          7
+
+#define BUS_MEM(p)           ((uint32_t)(p) | RPI_SPI_BUS_ALIAS)
+#define BUS_SPI_FIFO         0x7e204004
+
+typedef struct {
+  uint32_t ti;
+  uint32_t source_ad;
+  uint32_t dest_ad;
+  uint32_t txfr_len;
+  uint32_t stride;
+  uint32_t nextconbk;
+  uint32_t reserved[2];
+} dma_cb_t;
+
+static dma_cb_t dma_cb[2] __attribute__((aligned(32)));
+static uint32_t dma_tx[RPI_SPI_DMA_MAX / 4 + 1] __attribute__((aligned(32)));
+static uint8_t dma_rx[RPI_SPI_DMA_MAX] __attribute__((aligned(32)));
+
+static void rpi_spi_dma_isr(void *arg)
+{
+  DMA_CH(RPI_SPI_DMA_RX)[0] = DMA_CS_INT | DMA_CS_END;
+  rtems_event_send(xfer_waiter, RPI_SPI_EVENT);
+}
+
+static void dma_start(int ch, dma_cb_t *cb)
+{
+  DMA_CH(ch)[0] = DMA_CS_RESET;
+  DMA_CH(ch)[1] = BUS_MEM(cb);
+  DMA_CH(ch)[0] = DMA_CS_ACTIVE;
+}
+
+// Whole transfer in one message, the chip select is released at the end
+static rtems_status_code spi_dma_message(const rpi_spi_msg_t *m)
+{
+  rtems_status_code sc;
+
+  // the first word goes to DLEN and CS[7:0]
+  dma_tx[0] = (m->len << 16) | (spi_mode & 0xff) | CS_TA;
+  if (m->tx)
+    memcpy(&dma_tx[1], m->tx, m->len);
+  else
+    memset(&dma_tx[1], 0, m->len);
+
+  dma_cb[0].ti = DMA_TI_PERMAP(DREQ_SPI_TX) | DMA_TI_DEST_DREQ | DMA_TI_SRC_INC | DMA_TI_WAIT_RESP;
+  dma_cb[0].source_ad = BUS_MEM(dma_tx);
+  dma_cb[0].dest_ad = BUS_SPI_FIFO;
+  dma_cb[0].txfr_len = m->len + 4;
+
+  dma_cb[1].ti = DMA_TI_PERMAP(DREQ_SPI_RX) | DMA_TI_SRC_DREQ | DMA_TI_DEST_INC |
+    DMA_TI_WAIT_RESP | DMA_TI_INTEN;
+  dma_cb[1].source_ad = BUS_SPI_FIFO;
+  dma_cb[1].dest_ad = BUS_MEM(dma_rx);
+  dma_cb[1].txfr_len = m->len;
+
+  rtems_cache_flush_multiple_data_lines(dma_cb, sizeof (dma_cb));
+  rtems_cache_flush_multiple_data_lines(dma_tx, m->len + 4);
+  rtems_cache_invalidate_multiple_data_lines(dma_rx, m->len);
+
+  xfer_waiter = rtems_task_self();
+
+  SPI_CS = spi_mode | CS_DMAEN | CS_ADCS | CS_CLEAR;
+  dma_start(RPI_SPI_DMA_RX, &dma_cb[1]);
+  dma_start(RPI_SPI_DMA_TX, &dma_cb[0]);
+
+  sc = spi_wait();
+  if (sc != RTEMS_SUCCESSFUL) {
+    DMA_CH(RPI_SPI_DMA_TX)[0] = DMA_CS_RESET;
+    DMA_CH(RPI_SPI_DMA_RX)[0] = DMA_CS_RESET;
+  }
+  else if (m->rx) {
+    rtems_cache_invalidate_multiple_data_lines(dma_rx, m->len);
+    memcpy(m->rx, dma_rx, m->len);
+  }
+
+  SPI_CS = spi_mode;
+  if (sc == RTEMS_SUCCESSFUL)
+    spi_stats.dma++;
+
+  return sc;
+}
+#endif
+
+// Chained messages, returns the number of bytes moved or -1
+static int spi_transfer(const rpi_spi_msg_t *m)
+{
+  rtems_status_code sc = RTEMS_SUCCESSFUL;
+  int moved = 0;
+
+  rtems_semaphore_obtain(spi_lock, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+  spi_stats.transfers++;
+
+#ifdef RPI_SPI_DMA
+  if (m->next == NULL && m->len >= RPI_SPI_DMA_MIN && m->len <= RPI_SPI_DMA_MAX) {
+    sc = spi_dma_message(m);
+    if (sc == RTEMS_SUCCESSFUL) {
+      moved = m->len;
+      spi_stats.messages++;
+    }
+    m = NULL;
+  }
+#endif
+
+  for (; m; m = m->next) {
+    sc = spi_fifo_message(m);
+    if (sc != RTEMS_SUCCESSFUL)
+      break;
+
+    moved += m->len;
+    spi_stats.messages++;
+
+    if (m->cs_change || m->next == NULL)
+      SPI_CS = spi_mode;
+  }
+
+  spi_stats.bytes += moved;
+  rtems_semaphore_release(spi_lock);
+
+  return sc == RTEMS_SUCCESSFUL ? moved : -1;
+}
+
+rtems_device_driver rpi_spi_initialize(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_device_driver status;
+
+  if ( !initialized ) {
+    initialized = 1;
+
+    status = rtems_io_register_name(
+      "/dev/rpi_spi",
+      major,
+      (rtems_device_minor_number) 0
+    );
+
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+    // mode 0, CE0, 1 MHz
+    spi_mode = 0;
+    SPI_CS = CS_CLEAR;
+    SPI_CLK = SPI_CORE_HZ / 1000000;
+
+    status = rtems_semaphore_create(
+      rtems_build_name('S', 'P', 'I', '0'),
+      1,
+      RTEMS_BINARY_SEMAPHORE | RTEMS_PRIORITY | RTEMS_INHERIT_PRIORITY,
+      0,
+      &spi_lock
+    );
+
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+    status = rtems_interrupt_handler_install(
+      SPI_IRQ,
+      "SPI",
+      RTEMS_INTERRUPT_UNIQUE,
+      rpi_spi_isr,
+      NULL
+    );
+
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+#ifdef RPI_SPI_DMA
+    DMA_ENABLE |= (1 << RPI_SPI_DMA_TX) | (1 << RPI_SPI_DMA_RX);
+
+    status = rtems_interrupt_handler_install(
+      DMA_IRQ(RPI_SPI_DMA_RX),
+      "SPI DMA",
+      RTEMS_INTERRUPT_UNIQUE,
+      rpi_spi_dma_isr,
+      NULL
+    );
+
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+#endif
+  }
+
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_device_driver rpi_spi_open(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rpi_gpio_config_t pins;
+  int i;
+
+  // GPIO 7-11 to ALT0 on first use only, through the GPIO driver copy
+  // of GPFSEL0/1 (no store once they are set)
+  pins.mask = 0x1f << 7;
+  for (i = 7; i <= 11; i++)
+    pins.func[i] = RPI_GPIO_FSEL_ALT0;
+  rpi_gpio_config(&pins);
+
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_device_driver rpi_spi_close(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_device_driver rpi_spi_read(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_libio_rw_args_t *args = pargp;
+  rpi_spi_msg_t m;
+  int n;
+
+  memset(&m, 0, sizeof (m));
+  m.rx = (uint8_t *)args->buffer;
+  m.len = args->count;
+
+  n = spi_transfer(&m);
+  args->bytes_moved = (n < 0 ? 0 : n);
+
+  return n < 0 ? RTEMS_IO_ERROR : RTEMS_SUCCESSFUL;
+}
+
+rtems_device_driver rpi_spi_write(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_libio_rw_args_t *args = pargp;
+  rpi_spi_msg_t m;
+  int n;
+
+  memset(&m, 0, sizeof (m));
+  m.tx = (const uint8_t *)args->buffer;
+  m.len = args->count;
+
+  n = spi_transfer(&m);
+  args->bytes_moved = (n < 0 ? 0 : n);
+
+  return n < 0 ? RTEMS_IO_ERROR : RTEMS_SUCCESSFUL;
+}
+
+rtems_device_driver rpi_spi_control(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_libio_ioctl_args_t *args = pargp;
+  uint32_t arg, div;
+
+  arg = (uint32_t)(args->buffer);
+
+  switch (args->command) {
+  case RPI_SPI_MODE :
+    if (arg > 3)
+      goto invalid;
+    spi_mode = (spi_mode & ~(CS_CPOL | CS_CPHA)) |
+      ((arg & 2) ? CS_CPOL : 0) | ((arg & 1) ? CS_CPHA : 0);
+    break;
+
+  case RPI_SPI_SPEED :
+    if (arg == 0)
+      goto invalid;
+    // even divider, rounded up so the clock is never faster than asked
+    div = (SPI_CORE_HZ + arg - 1) / arg;
+    div = (div + 1) & ~1;
+    if (div < 2)
+      div = 2;
+    if (div > 65536)
+      div = 65536;
+    SPI_CLK = div & 0xffff;   // 0 is 65536
+    args->ioctl_return = SPI_CORE_HZ / div;
+    return RTEMS_SUCCESSFUL;
+
+  case RPI_SPI_CS :
+    if (arg > 1)
+      goto invalid;
+    spi_mode = (spi_mode & ~3) | arg;
+    break;
+
+  case RPI_SPI_TRANSFER :
+    args->ioctl_return = spi_transfer((rpi_spi_msg_t *)args->buffer);
+    return args->ioctl_return < 0 ? RTEMS_IO_ERROR : RTEMS_SUCCESSFUL;
+
+  case RPI_SPI_STATS :
+    *(rpi_spi_stats_t *)args->buffer = spi_stats;
+    break;
+
+  default :
+    goto invalid;
+  }
+
+  args->ioctl_return = 0;
+  return RTEMS_SUCCESSFUL;
+
+ invalid:
+  args->ioctl_return = -1;
+  return RTEMS_UNSATISFIED;
+}
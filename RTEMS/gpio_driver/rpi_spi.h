@@ -0,0 +1,114 @@
+#ifndef __RPI_SPI_DRIVER_h
+#define __RPI_SPI_DRIVER_h
+
+#include <rtems/libio.h>
+
+/*
+ * RTEMS SPI0 driver for RPi
+ *
+ * /dev/rpi_spi drives the BCM2835 SPI0 master on GPIO 7-11 (CE1, CE0,
+ * MISO, MOSI, SCLK). write() sends a block and drops what comes back,
+ * read() clocks out zeros and returns the received bytes, each call
+ * is one chip select cycle. Transfers are driven by the FIFO
+ * interrupts (RX FIFO 3/4 full and transfer done), the calling task
+ * sleeps meanwhile.
+ *
+ * Built with -DRPI_SPI_DMA, single message transfers of
+ * RPI_SPI_DMA_MIN to RPI_SPI_DMA_MAX bytes go through two DMA channels
+ * instead, with an interrupt on the end of the RX one.
+ *
+ * The pins are switched to ALT0 by open() with rpi_gpio_config(), an
+ * image that never opens the device leaves them alone. The GPIO driver
+ * must come first in the driver table.
+ *
+ * The driver uses one semaphore (bus lock), add it to
+ * CONFIGURE_MAXIMUM_SEMAPHORES.
+ */
+
+/* Driver cmds */
+#define RPI_SPI_MODE      0  /* arg is the SPI mode 0-3 (CPOL << 1 | CPHA) */
+#define RPI_SPI_SPEED     1  /* arg is the clock in Hz, returns the clock set */
+#define RPI_SPI_CS        2  /* arg is the chip select, 0 or 1 */
+#define RPI_SPI_TRANSFER  3  /* arg is a rpi_spi_msg_t *, returns bytes moved */
+#define RPI_SPI_STATS     4  /* arg is a rpi_spi_stats_t * */
+
+/* Task event used to wake up the task waiting for a transfer */
+#define RPI_SPI_EVENT     RTEMS_EVENT_29
+
+#define RPI_SPI_DMA_MIN   96
+#define RPI_SPI_DMA_MAX   4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RPI_SPI_TRANSFER message, full duplex: len bytes from tx are sent
+ * while len bytes are received into rx. A NULL tx sends zeros, a NULL
+ * rx drops the received bytes. Messages are chained with next, the
+ * chip select stays asserted from one message to the next unless
+ * cs_change is set, and is released after the last one.
+ */
+typedef struct rpi_spi_msg {
+  const uint8_t *tx;
+  uint8_t *rx;
+  uint32_t len;
+  uint32_t cs_change;
+  struct rpi_spi_msg *next;
+} rpi_spi_msg_t;
+
+typedef struct {
+  uint32_t transfers;   /* read(), write() and RPI_SPI_TRANSFER calls */
+  uint32_t messages;
+  uint32_t bytes;
+  uint32_t irqs;        /* SPI FIFO interrupts */
+  uint32_t dma;         /* messages moved by DMA */
+  uint32_t timeouts;
+} rpi_spi_stats_t;
+
+#define RPI_SPI_DRIVER_TABLE_ENTRY \
+  { rpi_spi_initialize, rpi_spi_open, rpi_spi_close, rpi_spi_read, \
+    rpi_spi_write, rpi_spi_control }
+
+rtems_device_driver rpi_spi_initialize(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_spi_open(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_spi_close(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_spi_read(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_spi_write(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_spi_control(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
@@ -0,0 +1,119 @@
+/*
+ * RPi SPI driver benchmark
+ *
+ * write() throughput and latency for several block sizes, then the
+ * latency of a two-message full-duplex transfer (command + reply, as
+ * for an ADC). Jumper MOSI (GPIO 10) to MISO (GPIO 9) to also check
+ * the data.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <rtems.h>
+#include <bsp.h>
+
+#include "rpi_spi.h"
+
+#define ST_CLO (*(volatile unsigned int *)BCM2835_GPU_TIMER_CLO) // system timer, 1 MHz
+
+#define SPI_BENCH_HZ     8000000
+#define SPI_BENCH_LOOPS  200
+
+static uint8_t tx_buf[RPI_SPI_DMA_MAX], rx_buf[RPI_SPI_DMA_MAX];
+
+static void bench_write (int fd, uint32_t size)
+{
+  uint32_t t, min = ~0, max = 0, total = 0;
+  int i;
+
+  for (i = 0; i < SPI_BENCH_LOOPS; i++) {
+    t = ST_CLO;
+    if (write (fd, tx_buf, size) != (ssize_t)size) {
+      fprintf (stderr, "write error => %d %s\n", errno, strerror(errno));
+      return;
+    }
+    t = ST_CLO - t;
+
+    if (t < min)
+      min = t;
+    if (t > max)
+      max = t;
+    total += t;
+  }
+
+  printf ("%6lu %8lu %8lu %8lu %10lu\n", (unsigned long)size, (unsigned long)min,
+	  (unsigned long)(total / SPI_BENCH_LOOPS), (unsigned long)max,
+	  (unsigned long)((uint64_t)size * SPI_BENCH_LOOPS * 1000 / total));
+}
+
+static void bench_transfer (int fd)
+{
+  rpi_spi_msg_t m[2];
+  uint8_t cmd[2] = { 0x01, 0x80 };
+  uint32_t t, min = ~0, max = 0;
+  int i, ok = 1;
+
+  memset (m, 0, sizeof (m));
+  m[0].tx = cmd;
+  m[0].rx = rx_buf;
+  m[0].len = sizeof (cmd);
+  m[0].next = &m[1];
+  m[1].tx = tx_buf;
+  m[1].rx = rx_buf + sizeof (cmd);
+  m[1].len = 16;
+
+  for (i = 0; i < SPI_BENCH_LOOPS; i++) {
+    t = ST_CLO;
+    if (ioctl (fd, RPI_SPI_TRANSFER, m) < 0) {
+      fprintf (stderr, "transfer error => %d %s\n", errno, strerror(errno));
+      return;
+    }
+    t = ST_CLO - t;
+
+    if (t < min)
+      min = t;
+    if (t > max)
+      max = t;
+  }
+
+  if (memcmp (rx_buf, cmd, sizeof (cmd)) || memcmp (rx_buf + sizeof (cmd), tx_buf, 16))
+    ok = 0;
+
+  printf ("2+16 bytes transfer: min %lu us, max %lu us, loopback %s\n",
+	  (unsigned long)min, (unsigned long)max, ok ? "ok" : "no data (MOSI not on MISO)");
+}
+
+void spi_benchmark (void)
+{
+  static const uint32_t sizes[] = { 4, 16, 64, 256, 1024, RPI_SPI_DMA_MAX };
+  rpi_spi_stats_t st;
+  unsigned int i;
+  int fd, hz;
+
+  if ((fd = open ("/dev/rpi_spi", O_RDWR)) < 0) {
+    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
+    return;
+  }
+
+  for (i = 0; i < sizeof (tx_buf); i++)
+    tx_buf[i] = i;
+
+  ioctl (fd, RPI_SPI_MODE, 0);
+  hz = ioctl (fd, RPI_SPI_SPEED, SPI_BENCH_HZ);
+
+  printf ("\nSPI0 at %d Hz, %d loops\n", hz, SPI_BENCH_LOOPS);
+  printf ("%6s %8s %8s %8s %10s\n", "bytes", "min(us)", "avg(us)", "max(us)", "kB/s");
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    bench_write (fd, sizes[i]);
+
+  bench_transfer (fd);
+
+  ioctl (fd, RPI_SPI_STATS, &st);
+  printf ("%lu transfers, %lu messages (%lu DMA), %lu bytes, %lu irqs, %lu timeouts\n",
+	  (unsigned long)st.transfers, (unsigned long)st.messages, (unsigned long)st.dma,
+	  (unsigned long)st.bytes, (unsigned long)st.irqs, (unsigned long)st.timeouts);
+
+  close (fd);
+}
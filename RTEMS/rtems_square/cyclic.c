@@ -0,0 +1,159 @@
+/*
+ * Table-driven cyclic executive for RPi
+ *
+ * One rate monotonic period is the minor frame, every slot of the
+ * table runs when (frame % divisor) == offset. The major frame is the
+ * largest divisor (harmonic rates). Each slot has a budget checked
+ * with the BCM2835 system timer, overruns are counted per slot.
+ */
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BCM2708_PERI_BASE    0x20000000
+#define GPIO_BASE            (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
+#define ST_BASE              (BCM2708_PERI_BASE + 0x3000)   /* system timer */
+
+#define OUT_GPIO(g) *(gpio_regs+((g)/10)) |=  (1<<(((g)%10)*3))
+#define GPIO_SET *(gpio_regs+7)  // sets   bits which are 1 ignores bits which are 0
+#define GPIO_CLR *(gpio_regs+10) // clears bits which are 1 ignores bits which are 0
+
+#define ST_CLO *((volatile unsigned int *)ST_BASE + 1) // 1 MHz free running counter
+
+#define GPIO_SQUARE  16
+#define GPIO_SLOW    20
+
+// Minor frame rate
+#define CYCLIC_RATE  1000 // Hz
+
+static volatile unsigned int *gpio_regs = (unsigned int *)GPIO_BASE;
+
+typedef struct {
+  const char *name;
+  uint32_t divisor;       // runs every divisor minor frames
+  uint32_t offset;        // in [0, divisor[, spreads slots over frames
+  void (*func)(void);
+  uint32_t budget;        // us
+
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t max;           // us
+} cyclic_slot_t;
+
+//
+// Activities
+//
+static void square_1khz (void)
+{
+  static int n;
+
+  if (n++ % 2)
+    GPIO_SET = 1 << GPIO_SQUARE;
+  else
+    GPIO_CLR = 1 << GPIO_SQUARE;
+}
+
+static volatile uint32_t filter_out;
+
+static void filter_250hz (void)
+{
+  static uint32_t acc;
+  int i;
+
+  // stand-in for a control law
+  for (i = 0; i < 64; i++)
+    acc = acc - (acc >> 4) + i;
+  filter_out = acc;
+}
+
+static void slow_10hz (void)
+{
+  static int n;
+
+  if (n++ % 2)
+    GPIO_SET = 1 << GPIO_SLOW;
+  else
+    GPIO_CLR = 1 << GPIO_SLOW;
+}
+
+static cyclic_slot_t cyclic_table[] = {
+  { "square",  1,   0, square_1khz,  20 },
+  { "filter",  4,   1, filter_250hz, 100 },
+  { "slow",    100, 2, slow_10hz,    20 },
+};
+
+#define CYCLIC_NSLOTS (sizeof (cyclic_table) / sizeof (cyclic_table[0]))
+
+static uint32_t frame_overruns;
+
+rtems_task Task_Cyclic_Executive (rtems_task_argument unused)
+{
+  rtems_status_code status;
+  rtems_id          RM_period;
+  rtems_interval    period_interval;
+  cyclic_slot_t     *s;
+  uint32_t          frame, major, i, t0, dt;
+
+  period_interval = rtems_clock_get_ticks_per_second() / CYCLIC_RATE;
+  if (period_interval == 0)
+    period_interval = 1;
+
+  major = 1;
+  for (i = 0; i < CYCLIC_NSLOTS; i++)
+    if (cyclic_table[i].divisor > major)
+      major = cyclic_table[i].divisor;
+
+  printf ("Cyclic executive: minor frame %d tick(s), major frame %d minor frames\n",
+	  (int)period_interval, (int)major);
+
+  OUT_GPIO(GPIO_SQUARE);
+  OUT_GPIO(GPIO_SLOW);
+
+  status = rtems_rate_monotonic_create( rtems_build_name( 'C', 'Y', 'C', 'L' ), &RM_period );
+  if( RTEMS_SUCCESSFUL != status ) {
+    printf("RM failed with status: %d\n", status);
+    exit(1);
+  }
+
+  frame = 0;
+  while( 1 ) {
+    // Block until the next minor frame
+    status = rtems_rate_monotonic_period (RM_period, period_interval);
+    if (status == RTEMS_TIMEOUT)
+      frame_overruns++;
+
+    for (i = 0; i < CYCLIC_NSLOTS; i++) {
+      s = &cyclic_table[i];
+      if (frame % s->divisor != s->offset)
+	continue;
+
+      t0 = ST_CLO;
+      s->func ();
+      dt = ST_CLO - t0;
+
+      s->runs++;
+      if (dt > s->max)
+	s->max = dt;
+      if (dt > s->budget)
+	s->overruns++;
+    }
+
+    if (++frame == major)
+      frame = 0;
+  }
+}
+
+void Cyclic_Report (void)
+{
+  cyclic_slot_t *s;
+  uint32_t i;
+
+  printf ("\n%-8s %4s %6s %8s %8s %8s\n", "slot", "div", "budget", "runs", "overruns", "max(us)");
+  for (i = 0; i < CYCLIC_NSLOTS; i++) {
+    s = &cyclic_table[i];
+    printf ("%-8s %4lu %6lu %8lu %8lu %8lu\n", s->name, (unsigned long)s->divisor,
+	    (unsigned long)s->budget, (unsigned long)s->runs, (unsigned long)s->overruns,
+	    (unsigned long)s->max);
+  }
+  printf ("frame overruns: %lu\n", (unsigned long)frame_overruns);
+}
@@ -12,12 +12,14 @@
 #include "system.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include "rtlog.h"
+#include "cycles.h"
 
 /*
  *  Keep the names and IDs in global variables so another task can use them.
  */
-rtems_id   Task_id[ 2 ];         /* array of task ids */
-rtems_name Task_name[ 2 ];       /* array of task names */
+rtems_id   Task_id[ 3 ];         /* array of task ids */
+rtems_name Task_name[ 3 ];       /* array of task names */
 
 rtems_task Init (rtems_task_argument argument)
 {
@@ -29,6 +31,12 @@ rtems_task Init (rtems_task_argument argument)
   ticks_per_second = rtems_clock_get_ticks_per_second();
   printf("\nTicks per second in your system: %" PRIu32 "\n", ticks_per_second);
 
+  // RT tasks log through the ring, printed from the lowest priority
+  status = rtlog_init( 254 );
+
+  // loop body execution time, see wcet.h
+  cycles_init();
+
   Task_name[ 1 ] = rtems_build_name( 'T', 'A', '1', ' ' );
 
   // prototype: rtems_task_create( name, initial_priority, stack_size, initial_modes, attribute_set, *id );
@@ -38,7 +46,25 @@ rtems_task Init (rtems_task_argument argument)
 			     );
 
   // prototype: rtems_task_start( id, entry_point, argument );
+#if defined(SQUARE_CYCLIC)
+  status = rtems_task_start( Task_id[ 1 ], Task_Cyclic_Executive, 1 );
+#elif defined(SQUARE_ABSOLUTE)
+  status = rtems_task_start( Task_id[ 1 ], Task_Absolute_Period, 1 );
+#elif defined(SQUARE_RELATIVE)
+  status = rtems_task_start( Task_id[ 1 ], Task_Relative_Period, 1 );
+#else
   status = rtems_task_start( Task_id[ 1 ], Task_Rate_Monotonic_Period, 1 );
+#endif
+
+  // Statistics reporter, lowest priority so it only uses the headroom
+  Task_name[ 2 ] = rtems_build_name( 'R', 'P', 'T', ' ' );
+
+  status = rtems_task_create(
+			     Task_name[ 2 ], 250, RTEMS_MINIMUM_STACK_SIZE * 2, RTEMS_DEFAULT_MODES,
+			     RTEMS_FLOATING_POINT, &Task_id[ 2 ]
+			     );
+
+  status = rtems_task_start( Task_id[ 2 ], Task_Report, 2 );
 
   // delete init task after starting the working task
   status = rtems_task_delete( RTEMS_SELF );
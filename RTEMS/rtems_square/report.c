@@ -0,0 +1,61 @@
+/*
+ * Period statistics and CPU usage reporter for RPi
+ *
+ * Low priority task, dumps a compact table of every rate monotonic
+ * period object then the per-task CPU usage
+ */
+#include "system.h"
+#include <stdio.h>
+#include <rtems/cpuuse.h>
+
+#define REPORT_PERIOD_S   5
+
+// timespec to us
+#define TS_US(_ts) ((uint64_t)(_ts).tv_sec * 1000000 + (_ts).tv_nsec / 1000)
+
+static void report_periods (void)
+{
+  rtems_rate_monotonic_period_statistics st;
+  rtems_id id;
+  uint32_t i, max;
+  char name[5];
+
+  printf ("\n%-4s %8s %6s %8s %8s %8s %8s %8s %8s\n", "PER", "count", "missed",
+	  "cpu min", "cpu max", "cpu avg", "wall min", "wall max", "wall avg");
+
+  max = rtems_configuration_get_rtems_api_configuration()->maximum_periods;
+  for (i = 1; i <= max; i++) {
+    id = rtems_build_id (OBJECTS_CLASSIC_API, OBJECTS_RTEMS_PERIODS, 1, i);
+
+    // unused slots are skipped
+    if (rtems_rate_monotonic_get_statistics (id, &st) != RTEMS_SUCCESSFUL)
+      continue;
+
+    rtems_object_get_name (id, sizeof (name), name);
+
+    if (st.count == 0) {
+      printf ("%-4s %8d %6d\n", name, 0, (int)st.missed_count);
+      continue;
+    }
+
+    printf ("%-4s %8lu %6lu %8lu %8lu %8lu %8lu %8lu %8lu\n", name,
+	    (unsigned long)st.count, (unsigned long)st.missed_count,
+	    (unsigned long)TS_US (st.min_cpu_time), (unsigned long)TS_US (st.max_cpu_time),
+	    (unsigned long)(TS_US (st.total_cpu_time) / st.count),
+	    (unsigned long)TS_US (st.min_wall_time), (unsigned long)TS_US (st.max_wall_time),
+	    (unsigned long)(TS_US (st.total_wall_time) / st.count));
+  }
+}
+
+rtems_task Task_Report (rtems_task_argument unused)
+{
+  while (1) {
+    rtems_task_wake_after (REPORT_PERIOD_S * rtems_clock_get_ticks_per_second());
+
+    report_periods ();
+#ifdef SQUARE_CYCLIC
+    Cyclic_Report ();
+#endif
+    rtems_cpu_usage_report ();
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * Deferred logging for RPi real-time tasks
+ *
+ * Bounded multi-producer ring, one consumer. Each slot has a sequence
+ * number: a producer owns slot pos once it moves head from pos to
+ * pos + 1 with a CAS, and publishes the record by setting seq to
+ * pos + 1. The consumer frees the slot by setting seq to pos + SIZE.
+ */
+#include <rtems.h>
+#include <stdio.h>
+#include "rtlog.h"
+
+#define RTLOG_POLL_MS  20
+
+typedef struct {
+  volatile uint32_t seq;
+  const char *fmt;
+  uint32_t args[RTLOG_NARGS];
+} rtlog_rec_t;
+
+static rtlog_rec_t rtlog_ring[RTLOG_SIZE];
+static volatile uint32_t rtlog_head;
+static uint32_t rtlog_tail;
+static volatile uint32_t rtlog_drops;
+static void (*volatile rtlog_fn)(void);
+
+int rtlog_write(const char *fmt, uint32_t a0, uint32_t a1, uint32_t a2,
+		uint32_t a3, uint32_t a4, uint32_t a5)
+{
+  rtlog_rec_t *r;
+  uint32_t pos;
+  int32_t dif;
+
+  pos = rtlog_head;
+  for (;;) {
+    r = &rtlog_ring[pos % RTLOG_SIZE];
+    dif = (int32_t)(r->seq - pos);
+    if (dif == 0) {
+      if (__sync_bool_compare_and_swap(&rtlog_head, pos, pos + 1))
+	break;
+    }
+    else if (dif < 0) {
+      // full, the consumer has not freed this slot yet
+      __sync_fetch_and_add(&rtlog_drops, 1);
+      return -1;
+    }
+    pos = rtlog_head;
+  }
+
+  r->fmt = fmt;
+  r->args[0] = a0;
+  r->args[1] = a1;
+  r->args[2] = a2;
+  r->args[3] = a3;
+  r->args[4] = a4;
+  r->args[5] = a5;
+
+  __sync_synchronize();
+  r->seq = pos + 1;
+
+  return 0;
+}
+
+uint32_t rtlog_dropped(void)
+{
+  return rtlog_drops;
+}
+
+// -1 if a call is already pending
+int rtlog_call(void (*fn)(void))
+{
+  return __sync_bool_compare_and_swap(&rtlog_fn, NULL, fn) ? 0 : -1;
+}
+
+static rtems_task rtlog_task(rtems_task_argument unused)
+{
+  rtlog_rec_t *r, rec;
+  uint32_t drops = 0;
+  void (*fn)(void);
+
+  while (1) {
+    r = &rtlog_ring[rtlog_tail % RTLOG_SIZE];
+
+    if ((int32_t)(r->seq - (rtlog_tail + 1)) < 0) {
+      // empty
+      if (rtlog_drops != drops) {
+	drops = rtlog_drops;
+	printf("rtlog: %lu record(s) dropped\n", (unsigned long)drops);
+      }
+      if ((fn = rtlog_fn) != NULL) {
+	rtlog_fn = NULL;
+	fn();
+	continue;
+      }
+      rtems_task_wake_after(RTEMS_MILLISECONDS_TO_TICKS(RTLOG_POLL_MS));
+      continue;
+    }
+
+    __sync_synchronize();
+    rec = *r;
+    __sync_synchronize();
+    r->seq = rtlog_tail + RTLOG_SIZE;
+    rtlog_tail++;
+
+    printf(rec.fmt, rec.args[0], rec.args[1], rec.args[2],
+	   rec.args[3], rec.args[4], rec.args[5]);
+  }
+}
+
+rtems_status_code rtlog_init(rtems_task_priority prio)
+{
+  rtems_status_code status;
+  rtems_id tid;
+  uint32_t i;
+
+  for (i = 0; i < RTLOG_SIZE; i++)
+    rtlog_ring[i].seq = i;
+
+  status = rtems_task_create(
+    rtems_build_name('R', 'L', 'O', 'G'), prio, RTEMS_MINIMUM_STACK_SIZE * 2,
+    RTEMS_DEFAULT_MODES, RTEMS_FLOATING_POINT, &tid
+  );
+
+  if (status != RTEMS_SUCCESSFUL)
+    return status;
+
+  return rtems_task_start(tid, rtlog_task, 0);
+}
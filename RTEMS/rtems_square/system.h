@@ -15,17 +15,35 @@
 
 /* functions */
 
+rtems_task Task_Absolute_Period(
+  rtems_task_argument argument
+);
+
 rtems_task Task_Rate_Monotonic_Period(
   rtems_task_argument argument
 );
 
+rtems_task Task_Relative_Period(
+  rtems_task_argument argument
+);
+
+rtems_task Task_Report(
+  rtems_task_argument argument
+);
+
+rtems_task Task_Cyclic_Executive(
+  rtems_task_argument argument
+);
+
+void Cyclic_Report(void);
+
 /* global variables */
 
 /*
  *  Keep the names and IDs in global variables so another task can use them.
  */ 
-extern rtems_id   Task_id[ 2 ];         /* array of task ids */
-extern rtems_name Task_name[ 2 ];       /* array of task names */
+extern rtems_id   Task_id[ 3 ];         /* array of task ids */
+extern rtems_name Task_name[ 3 ];       /* array of task names */
 
 
 
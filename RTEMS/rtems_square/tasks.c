@@ -8,6 +8,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <rtems/error.h>
+#include "rtlog.h"
+#include "wcet.h"
 
 #define BCM2708_PERI_BASE    0x20000000
 #define GPIO_BASE            (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
@@ -18,7 +20,11 @@
 
 #define GPIO_SET *(gpio+7)  // sets   bits which are 1 ignores bits which are 0
 #define GPIO_CLR *(gpio+10) // clears bits which are 1 ignores bits which are 0
-#define GPIO_READ(g) *(gpio+13) &= (1<<(g))
+#define GPIO_LEV *(gpio+13) // pin levels, read only
+#define GPIO_READ(g) (GPIO_LEV & (1<<(g)))
+
+#define ST_BASE              (BCM2708_PERI_BASE + 0x3000)   /* system timer */
+#define ST_CLO *((volatile unsigned int *)ST_BASE + 1) // 1 MHz free running counter
 
 #define GPIO_NR 16 //25
 
@@ -27,6 +33,52 @@ volatile unsigned int *gpio = (unsigned int *)GPIO_BASE;
 // Periods for the various tasks
 #define PERIOD_TASK_RATE_MONOTONIC     100 //2000
 
+#define RELEASE_REPORT                 500 // periods
+
+// Release time against the BCM2835 free running timer: error of each
+// release from one period to the next, and cumulative drift from the
+// ideal schedule t0 + n * period
+typedef struct {
+  const char *name;
+  uint32_t period_us;
+  uint32_t t0;
+  uint32_t n;
+  int32_t  drift;
+  int32_t  min, max;
+} release_stats_t;
+
+static void release_stamp (release_stats_t *r)
+{
+  uint32_t now = ST_CLO;
+  int32_t err;
+
+  if (r->n == 0)
+    r->t0 = now;
+
+  err = (int32_t)(now - (r->t0 + r->n * r->period_us));
+
+  if (r->n) {
+    if (r->n == 1 || err - r->drift < r->min)
+      r->min = err - r->drift;
+    if (r->n == 1 || err - r->drift > r->max)
+      r->max = err - r->drift;
+  }
+
+  r->drift = err;
+  r->n++;
+
+  if (r->n % RELEASE_REPORT == 0)
+    RTLOG ("%s: %lu periods, release error [%ld, %ld] us, drift %ld us\n", r->name,
+	   r->n, r->min, r->max, r->drift);
+}
+
+static void release_init (release_stats_t *r, const char *name, rtems_interval period_interval)
+{
+  r->name = name;
+  r->period_us = period_interval * rtems_configuration_get_microseconds_per_tick();
+  r->n = 0;
+}
+
 //
 // Rate Monotonic Scheduling
 //
@@ -37,6 +89,8 @@ rtems_task Task_Rate_Monotonic_Period (rtems_task_argument unused)
   rtems_id          RM_period;
   uint32_t          count;
   rtems_interval    period_interval;
+  release_stats_t   rs;
+  static wcet_t     wc;
 
   period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
   count = 0;
@@ -51,12 +105,17 @@ rtems_task Task_Rate_Monotonic_Period (rtems_task_argument unused)
     printf("RM failed with status: %d\n", status);
     exit(1);
   }
-  
+
+  release_init (&rs, "RM", period_interval);
+  wcet_init (&wc, "RM direct");
+
   while( 1 ) {
+    wcet_start (&wc);
     if (count % 2)
       GPIO_SET = 1 << GPIO_NR;
     else
       GPIO_CLR = 1 << GPIO_NR;
+    wcet_stop (&wc);
 
     count++;
 
@@ -65,7 +124,84 @@ rtems_task Task_Rate_Monotonic_Period (rtems_task_argument unused)
 
     // Overrun ?
     if (status == RTEMS_TIMEOUT) {
-      printf ("RM missed period !\n");
+      RTLOG ("RM missed period !\n");
     }
+
+    release_stamp (&rs);
+
+    if (count % RELEASE_REPORT == 0)
+      wcet_report (&wc);
+  }
+}
+
+//
+// Absolute period: the next release is computed from the previous
+// one, not from the wake-up time. rtems_task_wake_when() only has a
+// one second resolution, so the absolute date is kept in ticks and
+// turned into a relative delay just before sleeping.
+//
+rtems_task Task_Absolute_Period (rtems_task_argument unused)
+{
+  rtems_interval    period_interval, next, now;
+  uint32_t          count;
+  release_stats_t   rs;
+
+  period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
+  count = 0;
+  OUT_GPIO(GPIO_NR);
+
+  printf ("Absolute period interval: %d tick(s)\n", (int)period_interval);
+
+  release_init (&rs, "ABS", period_interval);
+  next = rtems_clock_get_ticks_since_boot();
+
+  while( 1 ) {
+    if (count % 2)
+      GPIO_SET = 1 << GPIO_NR;
+    else
+      GPIO_CLR = 1 << GPIO_NR;
+
+    count++;
+
+    next += period_interval;
+    now = rtems_clock_get_ticks_since_boot();
+    if ((int32_t)(next - now) > 0)
+      rtems_task_wake_after (next - now);
+    else
+      RTLOG ("ABS missed period !\n");
+
+    release_stamp (&rs);
+  }
+}
+
+//
+// Relative period: sleep one period after the work, the work time and
+// the wake-up latency add up period after period
+//
+rtems_task Task_Relative_Period (rtems_task_argument unused)
+{
+  rtems_interval    period_interval;
+  uint32_t          count;
+  release_stats_t   rs;
+
+  period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
+  count = 0;
+  OUT_GPIO(GPIO_NR);
+
+  printf ("Relative period interval: %d tick(s)\n", (int)period_interval);
+
+  release_init (&rs, "REL", period_interval);
+
+  while( 1 ) {
+    if (count % 2)
+      GPIO_SET = 1 << GPIO_NR;
+    else
+      GPIO_CLR = 1 << GPIO_NR;
+
+    count++;
+
+    rtems_task_wake_after (period_interval);
+
+    release_stamp (&rs);
   }
 }
@@ -0,0 +1,125 @@
+/*
+ * Start-up schedulability check for RPi periodic task sets
+ */
+#include <rtems.h>
+#include <stdio.h>
+#include "cycles.h"
+#include "admit.h"
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define ST_CLO *((volatile unsigned int *)(BCM2708_PERI_BASE + 0x3004)) // system timer, 1 MHz
+
+// CPU cycles per us, against the 1 MHz system timer over 10 ms
+static uint32_t cycles_per_us(void)
+{
+  uint32_t t0, c0;
+
+  t0 = ST_CLO;
+  while (ST_CLO == t0)
+    ;
+  t0 = ST_CLO;
+  c0 = cycles_read();
+  while (ST_CLO - t0 < 10000)
+    ;
+
+  return (cycles_read() - c0) / 10000;
+}
+
+void admit_calibrate(admit_task_t *set, int n)
+{
+  uint32_t c, max, mhz;
+  int i, k;
+
+  cycles_init();
+  mhz = cycles_per_us();
+
+  for (i = 0; i < n; i++) {
+    // the first run is the cold cache one, it is kept as well
+    max = 0;
+    for (k = 0; k < ADMIT_RUNS; k++) {
+      if (mhz) {
+	c = cycles_read();
+	set[i].job(set[i].arg);
+	c = cycles_read() - c;
+      }
+      else {
+	// no cycle counter (QEMU), 1 us resolution
+	c = ST_CLO;
+	set[i].job(set[i].arg);
+	c = ST_CLO - c;
+      }
+      if (c > max)
+	max = c;
+    }
+
+    if (mhz)
+      max /= mhz;
+
+    set[i].wcet_us = (max + 1) * (100 + ADMIT_MARGIN_PCT) / 100;
+  }
+}
+
+// Response time of task i, 0 when it exceeds the period
+static uint32_t response_time(admit_task_t *set, int n, int i)
+{
+  uint32_t r, prev;
+  int j;
+
+  r = set[i].wcet_us;
+  do {
+    prev = r;
+    r = set[i].wcet_us;
+    for (j = 0; j < n; j++) {
+      if (j == i || set[j].cpu != set[i].cpu || set[j].prio > set[i].prio)
+	continue;
+      r += (prev + set[j].period_us - 1) / set[j].period_us * set[j].wcet_us;
+    }
+    if (r > set[i].period_us)
+      return 0;
+  } while (r != prev);
+
+  return r;
+}
+
+// Returns the number of tasks that may miss their deadline
+int admit_check(admit_task_t *set, int n)
+{
+  uint32_t u;
+  int i, j, fail = 0;
+
+  printf ("\n%-8s %3s %4s %9s %8s %9s\n", "task", "cpu", "prio", "period", "wcet", "response");
+
+  for (i = 0; i < n; i++) {
+    set[i].response_us = response_time (set, n, i);
+    if (set[i].response_us == 0)
+      fail++;
+
+    printf ("%-8s %3lu %4lu %9lu %8lu ", set[i].name, (unsigned long)set[i].cpu,
+	    (unsigned long)set[i].prio, (unsigned long)set[i].period_us,
+	    (unsigned long)set[i].wcet_us);
+    if (set[i].response_us)
+      printf ("%9lu\n", (unsigned long)set[i].response_us);
+    else
+      printf ("%9s\n", "MISS");
+  }
+
+  // utilization per processor, for information
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < i; j++)
+      if (set[j].cpu == set[i].cpu)
+	break;
+    if (j < i)
+      continue;
+
+    u = 0;
+    for (j = i; j < n; j++)
+      if (set[j].cpu == set[i].cpu)
+	u += set[j].wcet_us * 1000 / set[j].period_us;
+    printf ("cpu %lu utilization %lu.%lu %%\n", (unsigned long)set[i].cpu,
+	    (unsigned long)(u / 10), (unsigned long)(u % 10));
+  }
+
+  return fail;
+}
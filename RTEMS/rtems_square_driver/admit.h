@@ -0,0 +1,40 @@
+/*
+ * Start-up schedulability check for RPi periodic task sets
+ *
+ * Each job is run a few times from Init and timed with the cycle
+ * counter, then the rate monotonic response time of every task is
+ * computed against the higher (and equal) priority tasks of the same
+ * processor: R = C + sum(ceil(R / Tj) * Cj), deadline = period.
+ */
+#ifndef __ADMIT_h
+#define __ADMIT_h
+
+#include <rtems.h>
+
+#define ADMIT_RUNS           20    /* calibration runs per job, max kept */
+#define ADMIT_MARGIN_PCT     20    /* added to the measured WCET */
+
+typedef struct {
+  const char *name;
+  void (*job)(void *arg);
+  void *arg;
+  uint32_t period_us;
+  rtems_task_priority prio;
+  uint32_t cpu;                 /* partition, 0 on uniprocessor */
+  uint32_t wcet_us;             /* set by admit_calibrate() */
+  uint32_t response_us;         /* set by admit_check(), 0 if unbounded */
+} admit_task_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void admit_calibrate(admit_task_t *set, int n);
+int admit_check(admit_task_t *set, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
@@ -0,0 +1,93 @@
+/*
+ * GPIO access benchmark for RPi: raw registers vs libio ioctl()
+ * on /dev/rpi_gpio and on the per-pin /dev/rpi_gpioN vs the driver
+ * fast path
+ *
+ * Build with DEFINES += -DGPIO_BENCH to run it from Init
+ */
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <rtems/error.h>
+#include "rpi_gpio.h"
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define GPIO_BASE            (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
+#define ST_BASE              (BCM2708_PERI_BASE + 0x3000)   /* system timer */
+
+#define GPIO_SET *(regs+7)  // sets   bits which are 1 ignores bits which are 0
+#define GPIO_CLR *(regs+10) // clears bits which are 1 ignores bits which are 0
+
+#define ST_CLO *((volatile unsigned int *)ST_BASE + 1) // 1 MHz free running counter
+
+#define BENCH_GPIO   16
+#define BENCH_DEV    "/dev/rpi_gpio16"  // per-pin device of BENCH_GPIO
+#define BENCH_LOOPS  100000
+
+static volatile unsigned int *regs = (unsigned int *)GPIO_BASE;
+
+// ns for one SET + CLR pair
+static void bench_print (const char *s, uint32_t t0, uint32_t t1)
+{
+  printf ("%-12s %6lu ns\n", s, (unsigned long)((uint64_t)(t1 - t0) * 1000 / BENCH_LOOPS));
+}
+
+void Benchmark_GPIO (void)
+{
+  rpi_gpio_handle_t h;
+  uint32_t t0, t1;
+  int fd, pin_fd, i;
+
+  if ((fd = open ("/dev/rpi_gpio", O_RDWR)) < 0 || (pin_fd = open (BENCH_DEV, O_RDWR)) < 0) {
+    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
+    exit (1);
+  }
+
+  ioctl (fd, RPI_GPIO_OUT, BENCH_GPIO);
+  rpi_gpio_handle_init (&h, BENCH_GPIO);
+
+  printf ("GPIO %d, %d SET/CLR pairs\n", BENCH_GPIO, BENCH_LOOPS);
+
+  // 1- raw register access
+  t0 = ST_CLO;
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    GPIO_SET = 1 << BENCH_GPIO;
+    GPIO_CLR = 1 << BENCH_GPIO;
+  }
+  t1 = ST_CLO;
+  bench_print ("raw", t0, t1);
+
+  // 2- POSIX ioctl() through libio
+  t0 = ST_CLO;
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    ioctl (fd, RPI_GPIO_SET, BENCH_GPIO);
+    ioctl (fd, RPI_GPIO_CLR, BENCH_GPIO);
+  }
+  t1 = ST_CLO;
+  bench_print ("ioctl", t0, t1);
+
+  // 3- per-pin device, no pin argument nor shift in the driver
+  t0 = ST_CLO;
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    ioctl (pin_fd, RPI_GPIO_SET, 0);
+    ioctl (pin_fd, RPI_GPIO_CLR, 0);
+  }
+  t1 = ST_CLO;
+  bench_print ("pin ioctl", t0, t1);
+
+  // 4- driver fast path
+  t0 = ST_CLO;
+  for (i = 0; i < BENCH_LOOPS; i++) {
+    rpi_gpio_fast_set (&h);
+    rpi_gpio_fast_clr (&h);
+  }
+  t1 = ST_CLO;
+  bench_print ("fast path", t0, t1);
+
+  close (pin_fd);
+  close (fd);
+}
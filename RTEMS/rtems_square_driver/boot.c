@@ -0,0 +1,110 @@
+/*
+ * Boot timeline and image size report for RPi
+ *
+ * boot_report() goes through rtlog, it is called from the square task
+ * right after its first release.
+ */
+#include <rtems.h>
+#include <stdio.h>
+#include "rtlog.h"
+#include "boot.h"
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define ST_CLO *((volatile unsigned int *)(BCM2708_PERI_BASE + 0x3004)) // system timer, 1 MHz
+
+// Section sizes from the ARM BSP linker command file
+extern char bsp_section_text_size[];
+extern char bsp_section_rodata_size[];
+extern char bsp_section_data_size[];
+extern char bsp_section_bss_size[];
+
+static const char *boot_name[BOOT_STAMPS] = {
+  "bsp start", "Init", "driver init", "first edge", "first release"
+};
+
+static uint32_t boot_time[BOOT_STAMPS];
+
+void boot_stamp(int step)
+{
+  if (boot_time[step] == 0)
+    boot_time[step] = ST_CLO;
+}
+
+#ifdef BOOT_BSP_STAMP
+// bsp_start() is called by boot_card(), before any RTEMS object exists
+void __real_bsp_start(void);
+
+void __wrap_bsp_start(void)
+{
+  boot_stamp(BOOT_BSP_START);
+  __real_bsp_start();
+}
+#endif
+
+rtems_device_driver boot_gpio_initialize(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_device_driver status;
+
+  status = rpi_gpio_initialize(major, minor, pargp);
+  boot_stamp(BOOT_DRIVER_INIT);
+
+  return status;
+}
+
+#ifdef SQUARE_LEAN
+// Task stacks come from here instead of the workspace, tasks are never
+// deleted (but Init, whose stack is not reused)
+#define LEAN_STACK_POOL      (8 * RTEMS_MINIMUM_STACK_SIZE)
+
+static char lean_stacks[LEAN_STACK_POOL] __attribute__((aligned(CPU_STACK_ALIGNMENT)));
+static size_t lean_used;
+
+void *lean_stack_alloc(size_t size)
+{
+  void *stack;
+
+  size = (size + CPU_STACK_ALIGNMENT - 1) & ~(CPU_STACK_ALIGNMENT - 1);
+  if (lean_used + size > sizeof (lean_stacks))
+    return NULL;
+
+  stack = &lean_stacks[lean_used];
+  lean_used += size;
+
+  return stack;
+}
+
+void lean_stack_free(void *stack)
+{
+}
+#endif
+
+void boot_report(void)
+{
+  uint32_t prev = 0;
+  int i;
+
+  for (i = 0; i < BOOT_STAMPS; i++) {
+    if (boot_time[i] == 0) {
+      RTLOG ("boot: %-14s -\n", boot_name[i]);
+      continue;
+    }
+    RTLOG ("boot: %-14s %8lu us  +%lu us\n", boot_name[i], boot_time[i],
+	   prev ? boot_time[i] - prev : 0);
+    prev = boot_time[i];
+  }
+
+  RTLOG ("image: text %lu, rodata %lu, data %lu, bss %lu bytes\n", bsp_section_text_size,
+	 bsp_section_rodata_size, bsp_section_data_size, bsp_section_bss_size);
+#ifdef SQUARE_LEAN
+  RTLOG ("workspace: %lu bytes, static stacks %lu/%lu bytes\n",
+	 rtems_configuration_get_work_space_size(), lean_used, LEAN_STACK_POOL);
+#else
+  RTLOG ("workspace: %lu bytes\n", rtems_configuration_get_work_space_size());
+#endif
+}
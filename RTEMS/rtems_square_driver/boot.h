@@ -0,0 +1,51 @@
+/*
+ * Boot timeline for RPi
+ *
+ * Time stamps from the BCM2835 system timer, which runs from power-on
+ * (GPU firmware boot included), so each stamp is the time since
+ * power-on in us. Only the first boot_stamp() of each step is kept.
+ */
+#ifndef __BOOT_h
+#define __BOOT_h
+
+#include <rtems.h>
+#include "rpi_gpio.h"
+
+enum {
+  BOOT_BSP_START,       /* bsp_start(), BOOT_BSP_STAMP + -Wl,--wrap=bsp_start */
+  BOOT_INIT,            /* Init task entry */
+  BOOT_DRIVER_INIT,     /* rpi_gpio driver initialized */
+  BOOT_FIRST_EDGE,      /* first GPIO write of the square task */
+  BOOT_FIRST_RELEASE,   /* first period release */
+  BOOT_STAMPS
+};
+
+/* rpi_gpio driver entry with a time stamp after its initialization */
+#define BOOT_GPIO_DRIVER_TABLE_ENTRY \
+  { boot_gpio_initialize, rpi_gpio_open, rpi_gpio_close, \
+    rpi_gpio_read, rpi_gpio_write, rpi_gpio_control }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void boot_stamp(int step);
+void boot_report(void);
+
+rtems_device_driver boot_gpio_initialize(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+#ifdef SQUARE_LEAN
+void *lean_stack_alloc(size_t size);
+void lean_stack_free(void *stack);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
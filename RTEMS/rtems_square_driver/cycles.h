@@ -0,0 +1,39 @@
+/*
+ * ARM cycle counter access for RPi
+ *
+ * ARM1176 (RPi 1) and Cortex-A7/A53 (RPi 2/3) have different
+ * performance monitor registers, both count CPU clock cycles on
+ * 32 bits (wraps after ~6 s at 700 MHz)
+ */
+#ifndef __CYCLES_h
+#define __CYCLES_h
+
+#include <stdint.h>
+
+static inline void cycles_init(void)
+{
+#if defined(__ARM_ARCH_7A__)
+  // PMCR: enable + reset CCNT, PMCNTENSET: enable CCNT
+  __asm__ volatile ("mcr p15, 0, %0, c9, c12, 0" :: "r" (1 | 4));
+  __asm__ volatile ("mcr p15, 0, %0, c9, c12, 1" :: "r" (0x80000000));
+#else
+  // ARM1176 PMNC: enable + reset CCNT
+  __asm__ volatile ("mcr p15, 0, %0, c15, c12, 0" :: "r" (1 | 4));
+#endif
+}
+
+static inline uint32_t cycles_read(void)
+{
+  uint32_t c;
+
+#if defined(__ARM_ARCH_7A__)
+  __asm__ volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (c));
+#else
+  __asm__ volatile ("mrc p15, 0, %0, c15, c12, 1" : "=r" (c));
+#endif
+
+  return c;
+}
+
+#endif
+/* end of include file */
@@ -12,6 +12,12 @@
 #include "system.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include "rtlog.h"
+
+#ifdef GPIO_TRACE
+#include "trace.h"
+#endif
 
 /*
  *  Keep the names and IDs in global variables so another task can use them.
@@ -19,12 +25,69 @@
 rtems_id   Task_id[ 2 ];         /* array of task ids */
 rtems_name Task_name[ 2 ];       /* array of task names */
 
+#define SQUARE_PRIORITY  1
+
+/*
+ *  Admission: time the periodic jobs and check the task set is
+ *  schedulable before anything starts. The square pin toggles a few
+ *  times during the calibration.
+ */
+static void admission (void)
+{
+#ifdef SQUARE_SMP
+  admit_task_t set[ 1 + SMP_LOAD_TASKS ];
+#else
+  admit_task_t set[ 1 ];
+#endif
+  int n = 0, fail;
+
+#ifndef SQUARE_PWM
+  set[ n ].name = "square";
+  set[ n ].job = Square_Job;
+  set[ n ].arg = NULL;
+#ifdef SQUARE_HRT
+  set[ n ].period_us = PERIOD_TASK_HRT_US;
+#else
+  set[ n ].period_us = 1000000 / PERIOD_TASK_RATE_MONOTONIC;
+#endif
+  set[ n ].prio = SQUARE_PRIORITY;
+  set[ n ].cpu = 0;
+  n++;
+#endif
+
+#ifdef SQUARE_SMP
+  n += SMP_Task_Set( &set[ n ] );
+#endif
+
+  // hardware square, nothing periodic to check
+  if ( n == 0 )
+    return;
+
+  Square_Setup();
+  admit_calibrate( set, n );
+  fail = admit_check( set, n );
+
+  if ( fail == 0 ) {
+    puts( "Task set is schedulable" );
+    return;
+  }
+
+#ifdef ADMIT_STRICT
+  printf( "%d task(s) may miss their deadline, not starting\n", fail );
+  exit( 1 );
+#else
+  printf( "WARNING: %d task(s) may miss their deadline\n", fail );
+#endif
+}
+
 rtems_task Init (rtems_task_argument argument)
 {
   rtems_status_code status;
   rtems_time_of_day time;
   uint32_t ticks_per_second;
 
+  boot_stamp( BOOT_INIT );
+
   puts( "\n\n\n*** RTEMS SQUARE ***" );
 
   ticks_per_second = rtems_clock_get_ticks_per_second();
@@ -40,16 +103,44 @@ rtems_task Init (rtems_task_argument argument)
 
   status = rtems_clock_set( &time );
 
+#ifdef GPIO_BENCH
+  Benchmark_GPIO();
+#endif
+
+  admission();
+
+#ifdef GPIO_TRACE
+  trace_init();
+#endif
+
+  // RT tasks log through the ring, printed from the lowest priority
+  status = rtlog_init( 254 );
+
   Task_name[ 1 ] = rtems_build_name( 'T', 'A', '1', ' ' );
 
   // prototype: rtems_task_create( name, initial_priority, stack_size, initial_modes, attribute_set, *id );
   status = rtems_task_create(
-			     Task_name[ 1 ], 1, RTEMS_MINIMUM_STACK_SIZE * 2, RTEMS_DEFAULT_MODES,
+			     Task_name[ 1 ], SQUARE_PRIORITY, RTEMS_MINIMUM_STACK_SIZE * 2, RTEMS_DEFAULT_MODES,
 			     RTEMS_DEFAULT_ATTRIBUTES, &Task_id[ 1 ]
 			     );
 
   // prototype: rtems_task_start( id, entry_point, argument );
+#if defined(SQUARE_PWM)
+  status = rtems_task_start( Task_id[ 1 ], Task_PWM_Output, 1 );
+#elif defined(SQUARE_HRT)
+  status = rtems_task_start( Task_id[ 1 ], Task_HRT_Period, 1 );
+#elif defined(SQUARE_ABSOLUTE)
+  status = rtems_task_start( Task_id[ 1 ], Task_Absolute_Period, 1 );
+#elif defined(SQUARE_RELATIVE)
+  status = rtems_task_start( Task_id[ 1 ], Task_Relative_Period, 1 );
+#else
   status = rtems_task_start( Task_id[ 1 ], Task_Rate_Monotonic_Period, 1 );
+#endif
+
+#ifdef SQUARE_SMP
+  // input, load and report tasks on the other cores
+  SMP_Start();
+#endif
 
   // delete init task after starting the working task
   status = rtems_task_delete( RTEMS_SELF );
@@ -2,23 +2,505 @@
  * RTEMS GPIO driver for RPi
  */
 #include <rtems.h>
+#include <rtems/irq-extension.h>
+#include <stdio.h>
+#include <string.h>
 #include "rpi_gpio.h"
 
-#define BCM2708_PERI_BASE    0x20000000
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
 #define GPIO_BASE            (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
 
-// GPIO setup macros
-#define INP_GPIO(g) *(gpio+((g)/10)) &= ~(7<<(((g)%10)*3))
-#define OUT_GPIO(g) *(gpio+((g)/10)) |=  (1<<(((g)%10)*3))
+#ifdef GPIO_TRACE
+#include "trace.h"
+#else
+#define trace_event(_event, _id, _arg)
+#endif
 
+#define GPIO_FSEL(k) *(gpio+(k))  // GPFSEL0-5, only written, see fsel_shadow
 #define GPIO_SET *(gpio+7)  // sets   bits which are 1 ignores bits which are 0
 #define GPIO_CLR *(gpio+10) // clears bits which are 1 ignores bits which are 0
-#define GPIO_READ(g) *(gpio+13) &= (1<<(g))
+#define GPIO_LEV *(gpio+13) // pin levels, read only
+#define GPIO_READ(g) (GPIO_LEV & (1<<(g)))
+
+#define GPIO_EDS *(gpio+16) // event detect status, write 1 to clear
+#define GPIO_REN *(gpio+19) // rising edge detect enable
+#define GPIO_FEN *(gpio+22) // falling edge detect enable
+
+#define GPIO_IRQ             49         /* gpio_int[0], bank 0 */
+#define ST_CLO               (*(volatile unsigned int *)(BCM2708_PERI_BASE + 0x3004)) /* system timer, 1 MHz */
+
+#define EVENT_RING_SIZE      64         /* power of 2 */
+
+// Clock manager, one CTL/DIV pair per clock, writes need the password
+#define CM_BASE              (BCM2708_PERI_BASE + 0x101000)
+#define CM_CTL(c)            *((volatile uint32_t *)CM_BASE + (c))
+#define CM_DIV(c)            *((volatile uint32_t *)CM_BASE + (c) + 1)
+#define CM_GP0               28         /* GP0CTL at 0x70, GP1 and GP2 follow */
+#define CM_PWM               40         /* PWMCTL at 0xa0 */
+#define CM_PASSWD            (0x5a << 24)
+#define CM_SRC_OSC           1          /* 19.2 MHz crystal */
+#define CM_ENAB              (1 << 4)
+#define CM_BUSY              (1 << 7)
+#define CM_OSC_HZ            19200000
+
+#define PWM_BASE             (BCM2708_PERI_BASE + 0x20c000)
+#define PWM_CTL              *((volatile uint32_t *)PWM_BASE + 0)
+#define PWM_RNG(ch)          *((volatile uint32_t *)PWM_BASE + 4 + (ch) * 4)
+#define PWM_DAT(ch)          *((volatile uint32_t *)PWM_BASE + 5 + (ch) * 4)
+#define PWM_PWEN             (1 << 0)   /* per channel, shifted by 8 * ch */
+#define PWM_MSEN             (1 << 7)
+#define PWM_DIVI             2          /* 9.6 MHz PWM clock */
+#define PWM_HZ               (CM_OSC_HZ / PWM_DIVI)
 
 volatile unsigned int *gpio = (unsigned int *)GPIO_BASE;
 
 static char initialized;
 
+// Protects the event ring and the waveform state, the GPIO interrupt
+// and the reader or writer may run on different cores
+RTEMS_INTERRUPT_LOCK_DEFINE(static, gpio_lock, "RPi GPIO")
+
+// Per-pin devices, resolved at open time
+static rpi_gpio_handle_t pin_handle[RPI_GPIO_NPINS];
+
+// GPLEV0 as seen by the last RPI_GPIO_READ_CHANGES
+static uint32_t last_levels;
+
+// Copy of GPFSEL0-5, loaded once at initialization. Pin functions are
+// computed from it and only the words that change are stored, the
+// registers are never read back. Protected by gpio_lock.
+static uint32_t fsel_shadow[RPI_GPIO_FSEL_WORDS];
+
+// Edge records, head is moved by the ISR and tail by read()
+static rpi_gpio_event_t event_ring[EVENT_RING_SIZE];
+static volatile unsigned int event_head, event_tail;
+static volatile uint32_t event_lost;
+static volatile rtems_id event_waiter;
+
+static void rpi_gpio_isr(void *arg)
+{
+  uint32_t eds, lev, ts;
+  rpi_gpio_event_t *e;
+  rtems_interrupt_lock_context lock_context;
+  rtems_id waiter;
+  int pin;
+
+  trace_event(TRACE_ISR_ENTRY, 0, 0);
+
+  ts = ST_CLO;
+  eds = GPIO_EDS;
+  GPIO_EDS = eds;
+  lev = GPIO_LEV;
+
+  rtems_interrupt_lock_acquire_isr(&gpio_lock, &lock_context);
+  while (eds) {
+    pin = __builtin_ctz(eds);
+    eds &= eds - 1;
+
+    if (event_head - event_tail == EVENT_RING_SIZE) {
+      event_lost++;
+      continue;
+    }
+
+    e = &event_ring[event_head % EVENT_RING_SIZE];
+    e->timestamp = ts;
+    e->pin = pin;
+    e->level = (lev >> pin) & 1;
+    event_head++;
+  }
+
+  waiter = event_waiter;
+  event_waiter = 0;
+  rtems_interrupt_lock_release_isr(&gpio_lock, &lock_context);
+
+  if (waiter)
+    rtems_event_send(waiter, RPI_GPIO_EVENT);
+
+  trace_event(TRACE_ISR_EXIT, 0, 0);
+}
+
+// Waveform chunks, filled by write() and played by the timer routine
+typedef struct {
+  rpi_gpio_step_t steps[RPI_GPIO_WAVE_STEPS];
+  uint32_t count;
+} wave_buf_t;
+
+static wave_buf_t wave_buf[2];
+static volatile int wave_ready[2];
+static volatile int wave_play = -1;  // buffer being played, -1 if idle
+static uint32_t wave_idx;
+static int wave_fill;                // next buffer for write()
+static rtems_id wave_timer, wave_sem;
+
+static rtems_timer_service_routine wave_fire(rtems_id timer, void *arg);
+
+// Apply zero-delay steps, returns the delay of the next delayed one (0
+// once playback is over) and the number of buffers given back
+static rtems_interval wave_next(uint32_t *done)
+{
+  rpi_gpio_step_t *s;
+
+  while (wave_play >= 0) {
+    if (wave_idx == wave_buf[wave_play].count) {
+      // chunk done, the buffer goes back to write()
+      wave_ready[wave_play] = 0;
+      (*done)++;
+      wave_play ^= 1;
+      wave_idx = 0;
+      if (!wave_ready[wave_play])
+	wave_play = -1;
+      continue;
+    }
+
+    s = &wave_buf[wave_play].steps[wave_idx];
+    if (s->delta)
+      return s->delta;
+
+    GPIO_SET = s->set;
+    GPIO_CLR = s->clr;
+    wave_idx++;
+  }
+
+  return 0;
+}
+
+// Directives are called once the lock is released
+static void wave_run(int fire)
+{
+  rtems_interrupt_lock_context lock_context;
+  rpi_gpio_step_t *s;
+  rtems_interval delta;
+  uint32_t done = 0;
+
+  rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+  if (fire) {
+    s = &wave_buf[wave_play].steps[wave_idx];
+    GPIO_SET = s->set;
+    GPIO_CLR = s->clr;
+    wave_idx++;
+  }
+  delta = wave_next(&done);
+  rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+
+  while (done--)
+    rtems_semaphore_release(wave_sem);
+
+  if (delta)
+    rtems_timer_fire_after(wave_timer, delta, wave_fire, NULL);
+}
+
+static rtems_timer_service_routine wave_fire(rtems_id timer, void *arg)
+{
+  wave_run(1);
+}
+
+static rtems_timer_service_routine wave_start(rtems_id timer, void *arg)
+{
+  wave_run(0);
+}
+
+int rpi_gpio_handle_init(rpi_gpio_handle_t *h, int pin)
+{
+  if (pin < 0 || pin >= RPI_GPIO_NPINS)
+    return -1;
+
+  h->set = (volatile uint32_t *)&GPIO_SET;
+  h->clr = (volatile uint32_t *)&GPIO_CLR;
+  h->lev = (volatile uint32_t *)&GPIO_LEV;
+  h->mask = 1 << pin;
+
+  return 0;
+}
+
+// Store the words of w that differ from the shadow, gpio_lock held
+static int fsel_commit(const uint32_t *w)
+{
+  int k, n = 0;
+
+  for (k = 0; k < RPI_GPIO_FSEL_WORDS; k++)
+    if (w[k] != fsel_shadow[k]) {
+      fsel_shadow[k] = w[k];
+      GPIO_FSEL(k) = w[k];
+      n++;
+    }
+
+  return n;
+}
+
+// Single pin version, one word at most and no read
+static void fsel_set(uint32_t pin, uint32_t func)
+{
+  rtems_interrupt_lock_context lock_context;
+  uint32_t k = pin / 10, shift = (pin % 10) * 3, w;
+
+  rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+  w = (fsel_shadow[k] & ~(7 << shift)) | (func << shift);
+  if (w != fsel_shadow[k]) {
+    fsel_shadow[k] = w;
+    GPIO_FSEL(k) = w;
+  }
+  rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+}
+
+int rpi_gpio_config(const rpi_gpio_config_t *cfg)
+{
+  rtems_interrupt_lock_context lock_context;
+  uint32_t w[RPI_GPIO_FSEL_WORDS];
+  uint32_t lo, hi, bits;
+  int k, shift, pin, n;
+
+  for (pin = 0; pin < RPI_GPIO_FSEL_PINS; pin++)
+    if (((cfg->mask >> pin) & 1) && cfg->func[pin] > 7)
+      return -1;
+
+  lo = (uint32_t)cfg->mask;
+  hi = (uint32_t)(cfg->mask >> 32);
+
+  rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+
+  // walk the pins word by word, no divide by 10 per pin
+  for (k = 0, pin = 0; k < RPI_GPIO_FSEL_WORDS; k++) {
+    w[k] = fsel_shadow[k];
+    for (shift = 0; shift < 30 && pin < RPI_GPIO_FSEL_PINS; shift += 3, pin++) {
+      bits = pin < 32 ? lo >> pin : hi >> (pin - 32);
+      if (bits & 1)
+	w[k] = (w[k] & ~(7 << shift)) | ((uint32_t)cfg->func[pin] << shift);
+    }
+  }
+
+  n = fsel_commit(w);
+
+  rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+
+  return n;
+}
+
+// PWM and general purpose clock pins of bank 0, unit is the PWM
+// channel or the GPCLK number
+typedef struct {
+  uint8_t pin;
+  uint8_t func;
+  uint8_t unit;
+} hw_pin_t;
+
+static const hw_pin_t pwm_pins[] = {
+  { 12, RPI_GPIO_FSEL_ALT0, 0 }, { 18, RPI_GPIO_FSEL_ALT5, 0 },
+  { 13, RPI_GPIO_FSEL_ALT0, 1 }, { 19, RPI_GPIO_FSEL_ALT5, 1 }
+};
+
+static const hw_pin_t gpclk_pins[] = {
+  { 4, RPI_GPIO_FSEL_ALT0, 0 }, { 20, RPI_GPIO_FSEL_ALT5, 0 },
+  { 5, RPI_GPIO_FSEL_ALT0, 1 }, { 21, RPI_GPIO_FSEL_ALT5, 1 },
+  { 6, RPI_GPIO_FSEL_ALT0, 2 }
+};
+
+static const hw_pin_t *hw_pin_find(const hw_pin_t *tab, int n, uint32_t pin)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (tab[i].pin == pin)
+      return &tab[i];
+
+  return NULL;
+}
+
+// Stop a clock, wait until it is idle, then start it with divider divi
+static void cm_start(int c, uint32_t divi)
+{
+  int i;
+
+  CM_CTL(c) = CM_PASSWD | CM_SRC_OSC;
+  for (i = 0; i < 100000 && (CM_CTL(c) & CM_BUSY); i++)
+    ;
+
+  if (divi) {
+    CM_DIV(c) = CM_PASSWD | (divi << 12);
+    CM_CTL(c) = CM_PASSWD | CM_SRC_OSC;
+    CM_CTL(c) = CM_PASSWD | CM_SRC_OSC | CM_ENAB;
+  }
+}
+
+static int pwm_setup(rpi_gpio_pwm_t *p)
+{
+  const hw_pin_t *hp;
+  uint32_t rng, shift;
+
+  if ((hp = hw_pin_find(pwm_pins, sizeof (pwm_pins) / sizeof (pwm_pins[0]), p->pin)) == NULL)
+    return -1;
+  if (p->freq > PWM_HZ / 2 || p->duty > 1000)
+    return -1;
+
+  shift = 8 * hp->unit;
+  PWM_CTL &= ~(0xff << shift);
+  p->actual = 0;
+
+  if (p->freq == 0) {
+    fsel_set(p->pin, RPI_GPIO_FSEL_IN);
+    return 0;
+  }
+
+  // the PWM clock is shared, it is only started once
+  if (!(CM_CTL(CM_PWM) & CM_ENAB) || (CM_DIV(CM_PWM) >> 12) != PWM_DIVI)
+    cm_start(CM_PWM, PWM_DIVI);
+
+  rng = PWM_HZ / p->freq;
+  PWM_RNG(hp->unit) = rng;
+  PWM_DAT(hp->unit) = (uint64_t)rng * p->duty / 1000;
+  PWM_CTL |= (PWM_PWEN | PWM_MSEN) << shift;
+
+  fsel_set(p->pin, hp->func);
+
+  p->actual = PWM_HZ / rng;
+
+  return 0;
+}
+
+static int gpclk_setup(rpi_gpio_pwm_t *p)
+{
+  const hw_pin_t *hp;
+  uint32_t divi;
+
+  if ((hp = hw_pin_find(gpclk_pins, sizeof (gpclk_pins) / sizeof (gpclk_pins[0]), p->pin)) == NULL)
+    return -1;
+
+  p->actual = 0;
+
+  if (p->freq == 0) {
+    cm_start(CM_GP0 + 2 * hp->unit, 0);
+    fsel_set(p->pin, RPI_GPIO_FSEL_IN);
+    return 0;
+  }
+
+  // integer divider only (no MASH), the duty cycle stays at 50 %
+  divi = (CM_OSC_HZ + p->freq / 2) / p->freq;
+  if (divi < 2 || divi > 4095)
+    return -1;
+
+  cm_start(CM_GP0 + 2 * hp->unit, divi);
+
+  fsel_set(p->pin, hp->func);
+
+  p->actual = CM_OSC_HZ / divi;
+
+  return 0;
+}
+
+// GPIO server
+static rtems_id server_queue, server_tid;
+static rtems_interval server_period;
+static rpi_gpio_server_stats_t server_stats;
+
+static rtems_task rpi_gpio_server(rtems_task_argument arg)
+{
+  rpi_gpio_req_t req;
+  size_t size;
+  uint32_t set, clr, batch, depth;
+  rtems_status_code sc;
+
+  while (1) {
+    if (server_period) {
+      rtems_task_wake_after(server_period);
+      sc = rtems_message_queue_receive(server_queue, &req, &size, RTEMS_NO_WAIT, 0);
+    }
+    else
+      sc = rtems_message_queue_receive(server_queue, &req, &size, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+
+    if (sc != RTEMS_SUCCESSFUL)
+      continue;
+
+    rtems_message_queue_get_number_pending(server_queue, &depth);
+    if (depth + 1 > server_stats.max_depth)
+      server_stats.max_depth = depth + 1;
+
+    // merge everything pending
+    set = clr = 0;
+    batch = 0;
+    do {
+      // GPSET0 then GPCLR0 order: clr wins inside a request
+      req.set &= ~req.clr;
+      set = (set & ~req.clr) | req.set;
+      clr = (clr & ~req.set) | req.clr;
+      batch++;
+    } while (rtems_message_queue_receive(server_queue, &req, &size, RTEMS_NO_WAIT, 0) == RTEMS_SUCCESSFUL);
+
+    GPIO_SET = set;
+    GPIO_CLR = clr;
+
+    server_stats.requests += batch;
+    server_stats.commits++;
+    if (batch > server_stats.max_batch)
+      server_stats.max_batch = batch;
+  }
+}
+
+rtems_status_code rpi_gpio_server_start(rtems_task_priority prio, rtems_interval period)
+{
+  rtems_status_code sc;
+
+  if (server_tid)
+    return RTEMS_RESOURCE_IN_USE;
+
+  server_period = period;
+
+  sc = rtems_message_queue_create(
+    rtems_build_name('G', 'S', 'R', 'V'),
+    RPI_GPIO_SERVER_DEPTH,
+    sizeof (rpi_gpio_req_t),
+    RTEMS_FIFO | RTEMS_LOCAL,
+    &server_queue
+  );
+
+  if (sc != RTEMS_SUCCESSFUL)
+    return sc;
+
+  sc = rtems_task_create(
+    rtems_build_name('G', 'S', 'R', 'V'), prio, RTEMS_MINIMUM_STACK_SIZE,
+    RTEMS_DEFAULT_MODES, RTEMS_DEFAULT_ATTRIBUTES, &server_tid
+  );
+
+  if (sc == RTEMS_SUCCESSFUL) {
+    sc = rtems_task_start(server_tid, rpi_gpio_server, 0);
+    if (sc != RTEMS_SUCCESSFUL)
+      rtems_task_delete(server_tid);
+  }
+
+  if (sc != RTEMS_SUCCESSFUL) {
+    rtems_message_queue_delete(server_queue);
+    server_queue = 0;
+    server_tid = 0;
+  }
+
+  return sc;
+}
+
+// May be called from any task or ISR, never blocks
+rtems_status_code rpi_gpio_server_post(uint32_t set, uint32_t clr)
+{
+  rpi_gpio_req_t req;
+  rtems_interrupt_lock_context lock_context;
+  rtems_status_code sc;
+
+  req.set = set;
+  req.clr = clr;
+
+  sc = rtems_message_queue_send(server_queue, &req, sizeof (req));
+  if (sc == RTEMS_TOO_MANY) {
+    rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+    server_stats.overflows++;
+    rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+  }
+
+  return sc;
+}
+
+void rpi_gpio_server_stats(rpi_gpio_server_stats_t *st)
+{
+  *st = server_stats;
+}
+
 rtems_device_driver rpi_gpio_initialize(
   rtems_device_major_number major,
   rtems_device_minor_number minor,
@@ -26,9 +508,16 @@ rtems_device_driver rpi_gpio_initialize(
 )
 {
   rtems_device_driver status;
+  char name[20];
+  int i;
 
   if ( !initialized ) {
     initialized = 1;
+    last_levels = GPIO_LEV;
+
+    // the only GPFSELn reads
+    for (i = 0; i < RPI_GPIO_FSEL_WORDS; i++)
+      fsel_shadow[i] = GPIO_FSEL(i);
 
     status = rtems_io_register_name(
       "/dev/rpi_gpio",
@@ -36,6 +525,50 @@ rtems_device_driver rpi_gpio_initialize(
       (rtems_device_minor_number) 0
     );
 
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+    for (i = 0; i < RPI_GPIO_NPINS; i++) {
+      snprintf(name, sizeof (name), "/dev/rpi_gpio%d", i);
+      status = rtems_io_register_name(
+        name,
+        major,
+        (rtems_device_minor_number) (i + 1)
+      );
+
+      if (status != RTEMS_SUCCESSFUL)
+        rtems_fatal_error_occurred(status);
+    }
+
+    // No edge detection until RPI_GPIO_EDGE
+    GPIO_REN = 0;
+    GPIO_FEN = 0;
+    GPIO_EDS = 0xffffffff;
+
+    status = rtems_interrupt_handler_install(
+      GPIO_IRQ,
+      "GPIO",
+      RTEMS_INTERRUPT_UNIQUE,
+      rpi_gpio_isr,
+      NULL
+    );
+
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+    status = rtems_timer_create(rtems_build_name('G', 'W', 'A', 'V'), &wave_timer);
+    if (status != RTEMS_SUCCESSFUL)
+      rtems_fatal_error_occurred(status);
+
+    // one unit per free chunk buffer
+    status = rtems_semaphore_create(
+      rtems_build_name('G', 'W', 'A', 'V'),
+      2,
+      RTEMS_COUNTING_SEMAPHORE | RTEMS_FIFO,
+      0,
+      &wave_sem
+    );
+
     if (status != RTEMS_SUCCESSFUL)
       rtems_fatal_error_occurred(status);
   }
@@ -49,6 +582,12 @@ rtems_device_driver rpi_gpio_open(
   void *pargp
 )
 {
+  if (minor > RPI_GPIO_NPINS)
+    return RTEMS_INVALID_NUMBER;
+
+  if (minor)
+    rpi_gpio_handle_init(&pin_handle[minor - 1], minor - 1);
+
   return RTEMS_SUCCESSFUL;
 }
 
@@ -61,17 +600,138 @@ rtems_device_driver rpi_gpio_close(
   return RTEMS_SUCCESSFUL;
 }
 
-rtems_device_driver rpi_gpio_control(
+// Only one task may block in read() at a time
+rtems_device_driver rpi_gpio_read(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_libio_rw_args_t *args = pargp;
+  rpi_gpio_event_t *e = (rpi_gpio_event_t *)args->buffer;
+  uint32_t n, max;
+  rtems_interrupt_lock_context lock_context;
+  rtems_event_set events;
+
+  args->bytes_moved = 0;
+  max = args->count / sizeof (rpi_gpio_event_t);
+  if (max == 0)
+    return RTEMS_INVALID_SIZE;
+
+  // Wait for at least one record
+  rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+  while (event_head == event_tail) {
+    if (args->flags & LIBIO_FLAGS_NO_DELAY) {
+      rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+      return RTEMS_SUCCESSFUL;
+    }
+
+    event_waiter = rtems_task_self();
+    rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+    rtems_event_receive(RPI_GPIO_EVENT, RTEMS_WAIT | RTEMS_EVENT_ANY,
+			RTEMS_NO_TIMEOUT, &events);
+    rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+  }
+
+  for (n = 0; n < max && event_tail != event_head; n++) {
+    e[n] = event_ring[event_tail % EVENT_RING_SIZE];
+    event_tail++;
+  }
+  rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+
+  args->bytes_moved = n * sizeof (rpi_gpio_event_t);
+
+  return RTEMS_SUCCESSFUL;
+}
+
+// Only one task may write waveforms at a time
+rtems_device_driver rpi_gpio_write(
   rtems_device_major_number major,
   rtems_device_minor_number minor,
   void *pargp
 )
+{
+  rtems_libio_rw_args_t *args = pargp;
+  rpi_gpio_step_t *steps = (rpi_gpio_step_t *)args->buffer;
+  uint32_t n, chunk;
+  rtems_interrupt_lock_context lock_context;
+  rtems_status_code sc;
+  int start;
+
+  args->bytes_moved = 0;
+  n = args->count / sizeof (rpi_gpio_step_t);
+
+  while (n) {
+    sc = rtems_semaphore_obtain(wave_sem,
+				(args->flags & LIBIO_FLAGS_NO_DELAY) ? RTEMS_NO_WAIT : RTEMS_WAIT,
+				RTEMS_NO_TIMEOUT);
+    if (sc != RTEMS_SUCCESSFUL)
+      break;
+
+    chunk = (n > RPI_GPIO_WAVE_STEPS ? RPI_GPIO_WAVE_STEPS : n);
+    memcpy(wave_buf[wave_fill].steps, steps, chunk * sizeof (rpi_gpio_step_t));
+    wave_buf[wave_fill].count = chunk;
+
+    rtems_interrupt_lock_acquire(&gpio_lock, &lock_context);
+    wave_ready[wave_fill] = 1;
+    start = (wave_play < 0);
+    if (start) {
+      wave_play = wave_fill;
+      wave_idx = 0;
+    }
+    rtems_interrupt_lock_release(&gpio_lock, &lock_context);
+
+    // first chunk after idle, playback starts on the next tick
+    if (start)
+      rtems_timer_fire_after(wave_timer, 1, wave_start, NULL);
+
+    wave_fill ^= 1;
+    steps += chunk;
+    n -= chunk;
+    args->bytes_moved += chunk * sizeof (rpi_gpio_step_t);
+  }
+
+  return RTEMS_SUCCESSFUL;
+}
+
+static rtems_device_driver rpi_gpio_ctl(
+  rtems_device_minor_number minor,
+  rtems_libio_ioctl_args_t *args
+)
 {
   int n, cmd;
-  rtems_libio_ioctl_args_t *args = pargp;
+  rpi_gpio_mask_t *m;
+  rpi_gpio_levels_t *l;
+  rpi_gpio_edge_t *ed;
+  uint32_t levels;
+  rpi_gpio_handle_t *h;
 
-  n = (int)(args->buffer);
   cmd = (int)(args->command);
+
+  if (minor) {
+    // per-pin device, no shift and no pin argument
+    h = &pin_handle[minor - 1];
+    switch (cmd) {
+    case RPI_GPIO_SET :
+      rpi_gpio_fast_set(h);
+      args->ioctl_return = 0;
+      return RTEMS_SUCCESSFUL;
+
+    case RPI_GPIO_CLR :
+      rpi_gpio_fast_clr(h);
+      args->ioctl_return = 0;
+      return RTEMS_SUCCESSFUL;
+
+    case RPI_GPIO_READ :
+      args->ioctl_return = rpi_gpio_fast_read(h);
+      return RTEMS_SUCCESSFUL;
+    }
+
+    n = minor - 1;
+  }
+  else
+    n = (int)(args->buffer);
+
   switch (cmd) {
   case RPI_GPIO_SET : 
     GPIO_SET = 1 << n;
@@ -82,17 +742,92 @@ rtems_device_driver rpi_gpio_control(
     break;
 
   case RPI_GPIO_OUT :
-    OUT_GPIO(n);
+  case RPI_GPIO_IN :
+    if ((unsigned)n >= RPI_GPIO_FSEL_PINS) {
+      args->ioctl_return = -1;
+      return RTEMS_INVALID_NUMBER;
+    }
+    fsel_set(n, cmd == RPI_GPIO_OUT ? RPI_GPIO_FSEL_OUT : RPI_GPIO_FSEL_IN);
     break;
 
-  case RPI_GPIO_IN :
-    INP_GPIO(n);
+  case RPI_GPIO_SET_MASK :
+    GPIO_SET = (uint32_t)(args->buffer);
+    break;
+
+  case RPI_GPIO_CLR_MASK :
+    GPIO_CLR = (uint32_t)(args->buffer);
+    break;
+
+  case RPI_GPIO_WRITE_MASK :
+    // one store per register, all pins of a bank move together
+    m = args->buffer;
+    GPIO_SET = m->value & m->mask;
+    GPIO_CLR = ~m->value & m->mask;
     break;
 
   case RPI_GPIO_READ :
-    args->ioctl_return = ((GPIO_READ(n) & (1 << n)) != 0);
+    args->ioctl_return = (GPIO_READ(n) != 0);
     return RTEMS_SUCCESSFUL;
 
+  case RPI_GPIO_READ_ALL :
+    *(uint32_t *)(args->buffer) = GPIO_LEV;
+    break;
+
+  case RPI_GPIO_READ_CHANGES :
+    // single register read, diff against the previous snapshot
+    l = args->buffer;
+    levels = GPIO_LEV;
+    l->levels = levels;
+    l->changed = levels ^ last_levels;
+    last_levels = levels;
+    break;
+
+  case RPI_GPIO_EDGE :
+    ed = args->buffer;
+    GPIO_REN = ed->rising;
+    GPIO_FEN = ed->falling;
+    GPIO_EDS = ed->rising | ed->falling; // drop stale events
+    break;
+
+  case RPI_GPIO_EVENT_LOST :
+    args->ioctl_return = event_lost;
+    return RTEMS_SUCCESSFUL;
+
+  case RPI_GPIO_WAVE_BUSY :
+    args->ioctl_return = wave_ready[0] + wave_ready[1];
+    return RTEMS_SUCCESSFUL;
+
+  case RPI_GPIO_POST :
+    if (rpi_gpio_server_post(((rpi_gpio_req_t *)args->buffer)->set,
+			     ((rpi_gpio_req_t *)args->buffer)->clr) != RTEMS_SUCCESSFUL) {
+      args->ioctl_return = -1;
+      return RTEMS_UNSATISFIED;
+    }
+    break;
+
+  case RPI_GPIO_SERVER_STATS :
+    rpi_gpio_server_stats(args->buffer);
+    break;
+
+  case RPI_GPIO_CONFIG :
+    if ((args->ioctl_return = rpi_gpio_config(args->buffer)) < 0)
+      return RTEMS_INVALID_NUMBER;
+    return RTEMS_SUCCESSFUL;
+
+  case RPI_GPIO_PWM :
+    if (pwm_setup(args->buffer) < 0) {
+      args->ioctl_return = -1;
+      return RTEMS_INVALID_NUMBER;
+    }
+    break;
+
+  case RPI_GPIO_GPCLK :
+    if (gpclk_setup(args->buffer) < 0) {
+      args->ioctl_return = -1;
+      return RTEMS_INVALID_NUMBER;
+    }
+    break;
+
   default: 
     printk ("rpi_gpio_control: unknown cmd %x\n", cmd); 
 
@@ -104,3 +839,18 @@ rtems_device_driver rpi_gpio_control(
 
   return RTEMS_SUCCESSFUL;
 }
+
+rtems_device_driver rpi_gpio_control(
+  rtems_device_major_number major,
+  rtems_device_minor_number minor,
+  void *pargp
+)
+{
+  rtems_device_driver status;
+
+  trace_event(TRACE_DRV_ENTRY, minor, ((rtems_libio_ioctl_args_t *)pargp)->command);
+  status = rpi_gpio_ctl(minor, pargp);
+  trace_event(TRACE_DRV_EXIT, minor, ((rtems_libio_ioctl_args_t *)pargp)->command);
+
+  return status;
+}
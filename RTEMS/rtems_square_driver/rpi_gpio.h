@@ -11,13 +11,222 @@
 #define RPI_GPIO_CLR     3
 #define RPI_GPIO_READ    4
 
+/* Multi-pin cmds, arg is a 32-bit pin mask (GPIO 0-31) */
+#define RPI_GPIO_SET_MASK   5
+#define RPI_GPIO_CLR_MASK   6
+#define RPI_GPIO_WRITE_MASK 7  /* arg is a rpi_gpio_mask_t * */
+
+/* Whole-bank reads */
+#define RPI_GPIO_READ_ALL     8  /* arg is a uint32_t *, gets GPLEV0 */
+#define RPI_GPIO_READ_CHANGES 9  /* arg is a rpi_gpio_levels_t * */
+
+/* Edge events, see read() */
+#define RPI_GPIO_EDGE         10 /* arg is a rpi_gpio_edge_t * */
+#define RPI_GPIO_EVENT_LOST   11 /* returns events dropped on ring overflow */
+
+/* Waveform playback, see write() */
+#define RPI_GPIO_WAVE_BUSY    12 /* returns number of chunks queued or playing */
+
+/* GPIO server, see rpi_gpio_server_start() */
+#define RPI_GPIO_POST         13 /* arg is a rpi_gpio_req_t * */
+#define RPI_GPIO_SERVER_STATS 14 /* arg is a rpi_gpio_server_stats_t * */
+
+/* Hardware square/PWM outputs, see rpi_gpio_pwm_t */
+#define RPI_GPIO_PWM          15 /* arg is a rpi_gpio_pwm_t * */
+#define RPI_GPIO_GPCLK        16 /* arg is a rpi_gpio_pwm_t * */
+
+/* Pin functions, see rpi_gpio_config_t */
+#define RPI_GPIO_CONFIG       17 /* arg is a rpi_gpio_config_t *, returns GPFSELn stores */
+
+/* Max steps per waveform chunk, two chunks are buffered */
+#define RPI_GPIO_WAVE_STEPS   64
+
+/* Task event used to wake up a reader blocked in read() */
+#define RPI_GPIO_EVENT        RTEMS_EVENT_31
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * RPI_GPIO_WRITE_MASK argument: pins in mask are driven to the
+ * corresponding bit of value, other pins are left untouched
+ */
+typedef struct {
+  uint32_t mask;
+  uint32_t value;
+} rpi_gpio_mask_t;
+
+/*
+ * RPI_GPIO_READ_CHANGES result: current GPLEV0 and the pins that
+ * changed since the previous READ_CHANGES call
+ */
+typedef struct {
+  uint32_t levels;
+  uint32_t changed;
+} rpi_gpio_levels_t;
+
+/* RPI_GPIO_EDGE argument: pins to watch for rising/falling edges */
+typedef struct {
+  uint32_t rising;
+  uint32_t falling;
+} rpi_gpio_edge_t;
+
+/*
+ * Edge record returned by read(). The level is sampled in the
+ * interrupt handler, the timestamp is the BCM2835 1 MHz system timer.
+ * read() blocks until at least one record is available unless the
+ * device was opened with O_NONBLOCK, in which case it returns 0.
+ */
+typedef struct {
+  uint32_t timestamp;   /* us */
+  uint8_t  pin;
+  uint8_t  level;
+  uint16_t reserved;
+} rpi_gpio_event_t;
+
+/*
+ * Waveform step written with write(): wait delta clock ticks after the
+ * previous step, then store set into GPSET0 and clr into GPCLR0.
+ * Steps are played from a timer service routine (clock tick ISR),
+ * playback starts on the tick following the first write(). Up to two
+ * chunks of RPI_GPIO_WAVE_STEPS are buffered, write() blocks while
+ * both are busy unless the device was opened with O_NONBLOCK.
+ *
+ * The driver uses one classic timer and one semaphore, add them to
+ * CONFIGURE_MAXIMUM_TIMERS and CONFIGURE_MAXIMUM_SEMAPHORES.
+ */
+typedef struct {
+  uint32_t delta;       /* ticks */
+  uint32_t set;
+  uint32_t clr;
+} rpi_gpio_step_t;
+
+/*
+ * Per-pin devices: /dev/rpi_gpioN (minor N + 1) drives GPIO N only.
+ * SET, CLR, READ, OUT and IN ignore their argument and use the pin
+ * resolved at open time, other cmds behave as on /dev/rpi_gpio.
+ */
+#define RPI_GPIO_NPINS   32
+
+/*
+ * Fast path for tasks linked with the driver: no file descriptor,
+ * no libio, the handle holds the register pointers and the pin mask.
+ * Pin direction is still set with RPI_GPIO_OUT / RPI_GPIO_IN.
+ */
+typedef struct {
+  volatile uint32_t *set;
+  volatile uint32_t *clr;
+  volatile uint32_t *lev;
+  uint32_t mask;
+} rpi_gpio_handle_t;
+
+int rpi_gpio_handle_init(rpi_gpio_handle_t *h, int pin);
+
+static inline void rpi_gpio_fast_set(const rpi_gpio_handle_t *h)
+{
+  *h->set = h->mask;
+}
+
+static inline void rpi_gpio_fast_clr(const rpi_gpio_handle_t *h)
+{
+  *h->clr = h->mask;
+}
+
+static inline int rpi_gpio_fast_read(const rpi_gpio_handle_t *h)
+{
+  return (*h->lev & h->mask) != 0;
+}
+
+/*
+ * Optional GPIO server: a driver task owns GPSET0/GPCLR0, producers
+ * post set/clear requests to its message queue. Every cycle the server
+ * drains all pending requests and writes the merged result with one
+ * GPSET0 and one GPCLR0 store, later requests win on conflicting pins
+ * (a pin in both set and clr of one request is cleared).
+ * With period 0 the server runs as soon as a request is pending,
+ * otherwise it wakes up every period ticks.
+ *
+ * Needs one more task, one message queue and
+ * CONFIGURE_MESSAGE_BUFFER_MEMORY for RPI_GPIO_SERVER_DEPTH requests,
+ * see init.c.
+ */
+#define RPI_GPIO_SERVER_DEPTH 32
+
+typedef struct {
+  uint32_t set;
+  uint32_t clr;
+} rpi_gpio_req_t;
+
+typedef struct {
+  uint32_t requests;    /* requests merged */
+  uint32_t commits;     /* GPSET0/GPCLR0 pairs written */
+  uint32_t max_batch;   /* most requests merged in one commit */
+  uint32_t max_depth;   /* most requests pending at wake-up */
+  uint32_t overflows;   /* requests refused, queue full */
+} rpi_gpio_server_stats_t;
+
+rtems_status_code rpi_gpio_server_start(rtems_task_priority prio, rtems_interval period);
+rtems_status_code rpi_gpio_server_post(uint32_t set, uint32_t clr);
+void rpi_gpio_server_stats(rpi_gpio_server_stats_t *st);
+
+/*
+ * RPI_GPIO_PWM / RPI_GPIO_GPCLK argument: route pin to the PWM block or
+ * to a general purpose clock and program it, no CPU is used afterwards.
+ *
+ * PWM: GPIO 12 or 18 (channel 0), 13 or 19 (channel 1), mark-space
+ * mode from a 9.6 MHz clock, any frequency up to 4.8 MHz, duty in per
+ * mille. Both channels share the clock but have their own period.
+ *
+ * GPCLK: GPIO 4 or 20 (GPCLK0), 5 or 21 (GPCLK1), 6 (GPCLK2), integer
+ * divider of the 19.2 MHz oscillator, 4.7 kHz to 9.6 MHz, duty is 50 %
+ * whatever duty says.
+ *
+ * freq 0 stops the output and puts the pin back to input. On return
+ * actual holds the frequency really generated (rounded divider).
+ */
+typedef struct {
+  uint32_t pin;
+  uint32_t freq;        /* Hz */
+  uint32_t duty;        /* per mille, PWM only */
+  uint32_t actual;      /* Hz, set by the driver */
+} rpi_gpio_pwm_t;
+
+/* Pin functions, as encoded in GPFSELn */
+#define RPI_GPIO_FSEL_IN      0
+#define RPI_GPIO_FSEL_OUT     1
+#define RPI_GPIO_FSEL_ALT0    4
+#define RPI_GPIO_FSEL_ALT1    5
+#define RPI_GPIO_FSEL_ALT2    6
+#define RPI_GPIO_FSEL_ALT3    7
+#define RPI_GPIO_FSEL_ALT4    3
+#define RPI_GPIO_FSEL_ALT5    2
+
+#define RPI_GPIO_FSEL_PINS    54         /* GPIO 0-53, 10 per GPFSELn */
+#define RPI_GPIO_FSEL_WORDS   6
+
+/*
+ * RPI_GPIO_CONFIG argument: func[n] is the new function of GPIO n for
+ * every n in mask, the other pins keep theirs. The driver keeps a copy
+ * of GPFSEL0-5 read once at initialization: the six words are built
+ * from it in one pass and only the words that change are stored,
+ * GPFSELn are never read back. RPI_GPIO_OUT, RPI_GPIO_IN, RPI_GPIO_PWM
+ * and RPI_GPIO_GPCLK go through the same copy, so does the SPI driver
+ * (rpi_gpio must come first in the driver table). Pin functions changed
+ * behind the driver's back are overwritten by the next store of their
+ * word.
+ */
+typedef struct {
+  uint64_t mask;
+  uint8_t  func[RPI_GPIO_FSEL_PINS];
+} rpi_gpio_config_t;
+
+/* Same as RPI_GPIO_CONFIG, returns the stores done or -1 */
+int rpi_gpio_config(const rpi_gpio_config_t *cfg);
+
 #define RPI_GPIO_DRIVER_TABLE_ENTRY \
-  { rpi_gpio_initialize, rpi_gpio_open, rpi_gpio_close, NULL, \
-    NULL, rpi_gpio_control }
+  { rpi_gpio_initialize, rpi_gpio_open, rpi_gpio_close, rpi_gpio_read, \
+    rpi_gpio_write, rpi_gpio_control }
 
 rtems_device_driver rpi_gpio_initialize(
   rtems_device_major_number,
@@ -37,6 +246,18 @@ rtems_device_driver rpi_gpio_close(
   void *
 );
 
+rtems_device_driver rpi_gpio_read(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
+rtems_device_driver rpi_gpio_write(
+  rtems_device_major_number,
+  rtems_device_minor_number,
+  void *
+);
+
 rtems_device_driver rpi_gpio_control(
   rtems_device_major_number,
   rtems_device_minor_number,
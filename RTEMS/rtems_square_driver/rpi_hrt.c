@@ -0,0 +1,144 @@
+/*
+ * High resolution timer service for RPi
+ */
+#include <rtems.h>
+#include <rtems/irq-extension.h>
+#include "rpi_hrt.h"
+
+#define ST_CS   *((volatile uint32_t *)RPI_HRT_ST_BASE)      // match flags, write 1 to clear
+#define ST_C3   *((volatile uint32_t *)RPI_HRT_ST_BASE + 6)  // compare 3
+
+#define ST_M3   (1 << 3)
+
+// wrap safe "a is before or at b"
+#define BEFORE_EQ(a, b) ((int32_t)((a) - (b)) <= 0)
+
+// Armed timers, sorted by deadline
+static rpi_hrt_timer_t *hrt_head;
+
+RTEMS_INTERRUPT_LOCK_DEFINE(static, hrt_lock, "HRT")
+
+static void hrt_insert(rpi_hrt_timer_t *t)
+{
+  rpi_hrt_timer_t **p = &hrt_head;
+
+  while (*p && BEFORE_EQ((*p)->deadline, t->deadline))
+    p = &(*p)->next;
+
+  t->next = *p;
+  *p = t;
+  t->armed = 1;
+}
+
+static void hrt_remove(rpi_hrt_timer_t *t)
+{
+  rpi_hrt_timer_t **p = &hrt_head;
+
+  while (*p && *p != t)
+    p = &(*p)->next;
+
+  if (*p)
+    *p = t->next;
+  t->armed = 0;
+}
+
+// Run expired timers and program the compare register for the next
+// one, handlers are called without the lock
+static void hrt_expire(void)
+{
+  rtems_interrupt_lock_context lock_context;
+  rpi_hrt_timer_t *t;
+  rpi_hrt_handler handler;
+  void *arg;
+
+  rtems_interrupt_lock_acquire_isr(&hrt_lock, &lock_context);
+  while (hrt_head) {
+    t = hrt_head;
+    if (!BEFORE_EQ(t->deadline, rpi_hrt_now())) {
+      ST_C3 = t->deadline;
+      // the deadline may have passed while programming C3
+      if (!BEFORE_EQ(t->deadline, rpi_hrt_now()))
+	break;
+      continue;
+    }
+
+    hrt_head = t->next;
+    t->armed = 0;
+    if (t->period) {
+      t->deadline += t->period;
+      hrt_insert(t);
+    }
+
+    handler = t->handler;
+    arg = t->arg;
+    rtems_interrupt_lock_release_isr(&hrt_lock, &lock_context);
+    handler(arg);
+    rtems_interrupt_lock_acquire_isr(&hrt_lock, &lock_context);
+  }
+  rtems_interrupt_lock_release_isr(&hrt_lock, &lock_context);
+}
+
+// From task context: no handler call, a late deadline fires in 2 us
+static void hrt_program(void)
+{
+  uint32_t now = rpi_hrt_now();
+
+  if (BEFORE_EQ(hrt_head->deadline, now + 1))
+    ST_C3 = now + 2;
+  else
+    ST_C3 = hrt_head->deadline;
+}
+
+static void hrt_isr(void *arg)
+{
+  ST_CS = ST_M3;
+  hrt_expire();
+}
+
+rtems_status_code rpi_hrt_initialize(void)
+{
+  ST_CS = ST_M3;
+
+  return rtems_interrupt_handler_install(
+    RPI_HRT_IRQ,
+    "HRT",
+    RTEMS_INTERRUPT_UNIQUE,
+    hrt_isr,
+    NULL
+  );
+}
+
+void rpi_hrt_start(rpi_hrt_timer_t *t, uint32_t deadline, uint32_t period,
+		   rpi_hrt_handler handler, void *arg)
+{
+  rtems_interrupt_lock_context lock_context;
+
+  rtems_interrupt_lock_acquire(&hrt_lock, &lock_context);
+  if (t->armed)
+    hrt_remove(t);
+
+  t->deadline = deadline;
+  t->period = period;
+  t->handler = handler;
+  t->arg = arg;
+  hrt_insert(t);
+
+  if (hrt_head == t)
+    hrt_program();
+  rtems_interrupt_lock_release(&hrt_lock, &lock_context);
+}
+
+void rpi_hrt_cancel(rpi_hrt_timer_t *t)
+{
+  rtems_interrupt_lock_context lock_context;
+
+  rtems_interrupt_lock_acquire(&hrt_lock, &lock_context);
+  if (t->armed)
+    hrt_remove(t);
+  rtems_interrupt_lock_release(&hrt_lock, &lock_context);
+}
+
+void rpi_hrt_release_task(void *arg)
+{
+  rtems_event_send((rtems_id)(uintptr_t)arg, RPI_HRT_EVENT);
+}
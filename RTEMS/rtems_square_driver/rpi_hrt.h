@@ -0,0 +1,60 @@
+/*
+ * High resolution timer service for RPi
+ *
+ * Built on the BCM2835 free running system timer (1 MHz) and its
+ * compare channel 3 (channels 0 and 2 belong to the GPU, 1 is left
+ * free). Deadlines are absolute, in us, on the 32-bit CLO counter
+ * and are independent from the RTEMS clock tick. Handlers run in
+ * interrupt context: toggle GPIOs, send events or release semaphores.
+ */
+#ifndef __RPI_HRT_h
+#define __RPI_HRT_h
+
+#include <rtems.h>
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define RPI_HRT_ST_BASE      (BCM2708_PERI_BASE + 0x3000)  /* system timer */
+#define RPI_HRT_IRQ          3           /* system timer match 3 */
+
+/* Event sent by rpi_hrt_release_task() */
+#define RPI_HRT_EVENT        RTEMS_EVENT_30
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*rpi_hrt_handler)(void *arg);
+
+typedef struct rpi_hrt_timer {
+  uint32_t deadline;            /* us, absolute */
+  uint32_t period;              /* us, 0 for one shot */
+  rpi_hrt_handler handler;
+  void *arg;
+  struct rpi_hrt_timer *next;
+  int armed;
+} rpi_hrt_timer_t;
+
+static inline uint32_t rpi_hrt_now(void)
+{
+  return *((volatile uint32_t *)RPI_HRT_ST_BASE + 1);
+}
+
+rtems_status_code rpi_hrt_initialize(void);
+
+/* Arm t to fire at deadline then every period us (0: one shot) */
+void rpi_hrt_start(rpi_hrt_timer_t *t, uint32_t deadline, uint32_t period,
+		   rpi_hrt_handler handler, void *arg);
+
+void rpi_hrt_cancel(rpi_hrt_timer_t *t);
+
+/* Handler releasing the task whose id is arg with RPI_HRT_EVENT */
+void rpi_hrt_release_task(void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
@@ -0,0 +1,43 @@
+/*
+ * Deferred logging for RPi real-time tasks
+ *
+ * RTLOG() stores a fixed-size record (format string pointer + up to
+ * 6 word-sized arguments) in a preallocated lock-free ring and returns
+ * at once, the lowest priority rtlog task does the printf(). Format
+ * strings must be literals (the pointer is the format id), arguments
+ * are 32-bit words: integers or pointers to static strings.
+ * RTLOG() never blocks, records are dropped and counted when the ring
+ * is full. Safe from tasks and ISRs.
+ *
+ * rtlog_call() hands a longer job (a trace dump...) to the rtlog task,
+ * it runs once the ring is empty. One call pending at most.
+ */
+#ifndef __RTLOG_h
+#define __RTLOG_h
+
+#include <rtems.h>
+
+#define RTLOG_SIZE     64    /* records, power of 2 */
+#define RTLOG_NARGS    6
+
+#define RTLOG(...)     RTLOG_(__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0)
+#define RTLOG_(fmt, a0, a1, a2, a3, a4, a5, ...)			\
+  rtlog_write(fmt, (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2),	\
+	      (uint32_t)(a3), (uint32_t)(a4), (uint32_t)(a5))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+rtems_status_code rtlog_init(rtems_task_priority prio);
+int rtlog_write(const char *fmt, uint32_t a0, uint32_t a1, uint32_t a2,
+		uint32_t a3, uint32_t a4, uint32_t a5);
+uint32_t rtlog_dropped(void);
+int rtlog_call(void (*fn)(void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
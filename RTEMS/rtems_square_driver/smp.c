@@ -0,0 +1,277 @@
+/*
+ * SMP layout for quad-core RPi 2/3
+ *
+ * One priority scheduler per core (partitioned): the square task
+ * stays on core 0 with Init, the GPIO input task runs on core 1 and
+ * SMP_LOAD_TASKS periodic load tasks are spread over cores 1 to 3.
+ * A low priority task prints per-core load and missed periods.
+ */
+#ifdef SQUARE_SMP
+
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <rtems/cpuuse.h>
+#include <rtems/error.h>
+#include "rtlog.h"
+#include "rpi_gpio.h"
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define ST_CLO *((volatile unsigned int *)(BCM2708_PERI_BASE + 0x3004)) // system timer, 1 MHz
+
+#define SMP_INPUT_GPIO       24
+#define SMP_LOAD_PERIOD_MS   10
+#define SMP_LOAD_BUSY_US     3000  // per period, 30 % of a core
+#define SMP_LOAD_PRIO        10
+#define SMP_REPORT_S         5
+
+// timespec to us
+#define TS_US(_ts) ((uint64_t)(_ts).tv_sec * 1000000 + (_ts).tv_nsec / 1000)
+
+typedef struct {
+  uint32_t periods;     // period objects owned by tasks of this core
+  uint32_t count;
+  uint32_t missed;
+  uint64_t cpu_us;      // total CPU time of the periodic jobs
+} core_stats_t;
+
+static rtems_id core_sched[SMP_CPUS];
+static core_stats_t core_last[SMP_CPUS];
+static uint32_t n_cpus;
+
+// Input task counters, written on core 1 only
+static volatile uint32_t input_edges;
+static volatile uint32_t input_max_latency;
+
+static int core_of_task (rtems_id tid)
+{
+  rtems_id sched;
+  uint32_t cpu;
+
+  if (rtems_task_get_scheduler (tid, &sched) != RTEMS_SUCCESSFUL)
+    return -1;
+
+  for (cpu = 0; cpu < n_cpus; cpu++)
+    if (core_sched[cpu] == sched)
+      return cpu;
+
+  return -1;
+}
+
+// Move a created (not yet started) task to the scheduler of a core
+static rtems_status_code smp_task_start (rtems_name name, rtems_task_priority prio, uint32_t cpu,
+					 rtems_task_entry entry, rtems_task_argument arg)
+{
+  rtems_status_code status;
+  rtems_id tid;
+
+  status = rtems_task_create (name, prio, RTEMS_MINIMUM_STACK_SIZE * 2, RTEMS_DEFAULT_MODES,
+			      RTEMS_FLOATING_POINT, &tid);
+  if (status != RTEMS_SUCCESSFUL)
+    return status;
+
+  if (cpu < n_cpus && core_sched[cpu] != core_sched[0]) {
+    status = rtems_task_set_scheduler (tid, core_sched[cpu], prio);
+    if (status != RTEMS_SUCCESSFUL)
+      return status;
+  }
+
+  return rtems_task_start (tid, entry, arg);
+}
+
+//
+// Input edges from the driver, latency from the ISR time stamp
+//
+static rtems_task Task_Input (rtems_task_argument unused)
+{
+  rpi_gpio_event_t ev[8];
+  rpi_gpio_edge_t edge;
+  uint32_t lat;
+  ssize_t n;
+  int i, in_fd;
+
+  if ((in_fd = open ("/dev/rpi_gpio", O_RDWR)) < 0) {
+    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
+    rtems_task_delete (RTEMS_SELF);
+  }
+
+  ioctl (in_fd, RPI_GPIO_IN, SMP_INPUT_GPIO);
+  edge.rising = 1 << SMP_INPUT_GPIO;
+  edge.falling = 1 << SMP_INPUT_GPIO;
+  ioctl (in_fd, RPI_GPIO_EDGE, &edge);
+
+  while (1) {
+    if ((n = read (in_fd, ev, sizeof (ev))) <= 0)
+      continue;
+
+    for (i = 0; i < n / (ssize_t)sizeof (rpi_gpio_event_t); i++) {
+      lat = ST_CLO - ev[i].timestamp;
+      if (lat > input_max_latency)
+	input_max_latency = lat;
+      input_edges++;
+    }
+  }
+}
+
+// Load task i runs on cores 2, 3, 1, 2...
+static uint32_t load_cpu (uint32_t i)
+{
+  return n_cpus > 1 ? 1 + (i + 1) % (n_cpus - 1) : 0;
+}
+
+static void Load_Job (void *unused)
+{
+  uint32_t t0;
+
+  t0 = ST_CLO;
+  while (ST_CLO - t0 < SMP_LOAD_BUSY_US)
+    ;
+}
+
+//
+// Periodic CPU hog, one per load task
+//
+static rtems_task Task_Load (rtems_task_argument index)
+{
+  rtems_id period;
+  rtems_interval ticks;
+
+  ticks = rtems_clock_get_ticks_per_second() * SMP_LOAD_PERIOD_MS / 1000;
+
+  if (rtems_rate_monotonic_create (rtems_build_name ('L', 'D', 'P', '0' + index), &period)
+      != RTEMS_SUCCESSFUL) {
+    RTLOG ("LD%lu: no period\n", index);
+    rtems_task_delete (RTEMS_SELF);
+  }
+
+  while (1) {
+    if (rtems_rate_monotonic_period (period, ticks) == RTEMS_TIMEOUT)
+      RTLOG ("LD%lu missed period !\n", index);
+
+    Load_Job (NULL);
+  }
+}
+
+//
+// Per-core statistics, from the period objects of the tasks of each core
+//
+static void smp_report (uint32_t elapsed_us)
+{
+  rtems_rate_monotonic_period_statistics st;
+  rtems_rate_monotonic_period_status ps;
+  core_stats_t now[SMP_CPUS];
+  rtems_id id;
+  uint32_t i, max, cpu;
+  int c;
+
+  memset (now, 0, sizeof (now));
+
+  max = rtems_configuration_get_rtems_api_configuration()->maximum_periods;
+  for (i = 1; i <= max; i++) {
+    id = rtems_build_id (OBJECTS_CLASSIC_API, OBJECTS_RTEMS_PERIODS, 1, i);
+
+    // unused slots are skipped
+    if (rtems_rate_monotonic_get_statistics (id, &st) != RTEMS_SUCCESSFUL)
+      continue;
+    if (rtems_rate_monotonic_get_status (id, &ps) != RTEMS_SUCCESSFUL)
+      continue;
+    if ((c = core_of_task (ps.owner)) < 0)
+      continue;
+
+    now[c].periods++;
+    now[c].count += st.count;
+    now[c].missed += st.missed_count;
+    now[c].cpu_us += TS_US (st.total_cpu_time);
+  }
+
+  printf ("\n%-4s %7s %8s %6s %7s\n", "CPU", "periods", "count", "missed", "load %");
+  for (cpu = 0; cpu < n_cpus; cpu++) {
+    printf ("%-4lu %7lu %8lu %6lu %7lu\n", (unsigned long)cpu,
+	    (unsigned long)now[cpu].periods, (unsigned long)now[cpu].count,
+	    (unsigned long)(now[cpu].missed - core_last[cpu].missed),
+	    (unsigned long)((now[cpu].cpu_us - core_last[cpu].cpu_us) * 100 / elapsed_us));
+    core_last[cpu] = now[cpu];
+  }
+
+  printf ("input: %lu edges, max latency %lu us, rtlog dropped %lu\n",
+	  (unsigned long)input_edges, (unsigned long)input_max_latency,
+	  (unsigned long)rtlog_dropped ());
+}
+
+static rtems_task Task_SMP_Report (rtems_task_argument unused)
+{
+  uint32_t t0, t1;
+
+  t0 = ST_CLO;
+  while (1) {
+    rtems_task_wake_after (SMP_REPORT_S * rtems_clock_get_ticks_per_second());
+
+    t1 = ST_CLO;
+    smp_report (t1 - t0);
+    t0 = t1;
+
+    // IDLE lines give the real per-core load, the input task included
+    rtems_cpu_usage_report ();
+  }
+}
+
+// Load tasks for the admission check
+int SMP_Task_Set (admit_task_t *set)
+{
+  static const char *names[] = { "LD0", "LD1", "LD2", "LD3", "LD4", "LD5", "LD6", "LD7" };
+  uint32_t i;
+
+  n_cpus = rtems_get_processor_count ();
+  if (n_cpus > SMP_CPUS)
+    n_cpus = SMP_CPUS;
+
+  for (i = 0; i < SMP_LOAD_TASKS; i++) {
+    set[i].name = names[i];
+    set[i].job = Load_Job;
+    set[i].arg = NULL;
+    set[i].period_us = SMP_LOAD_PERIOD_MS * 1000;
+    set[i].prio = SMP_LOAD_PRIO;
+    set[i].cpu = load_cpu (i);
+  }
+
+  return SMP_LOAD_TASKS;
+}
+
+void SMP_Start (void)
+{
+  rtems_status_code status;
+  uint32_t cpu, i;
+
+  n_cpus = rtems_get_processor_count ();
+  if (n_cpus > SMP_CPUS)
+    n_cpus = SMP_CPUS;
+
+  for (cpu = 0; cpu < n_cpus; cpu++)
+    if (rtems_scheduler_ident_by_processor (cpu, &core_sched[cpu]) != RTEMS_SUCCESSFUL)
+      core_sched[cpu] = core_sched[0];
+
+  printf ("SMP: %lu processor(s), %d load task(s)\n", (unsigned long)n_cpus, SMP_LOAD_TASKS);
+
+  status = smp_task_start (rtems_build_name ('I', 'N', 'P', ' '), 2, 1, Task_Input, 0);
+  if (status != RTEMS_SUCCESSFUL)
+    printf ("input task failed with status: %d\n", status);
+
+  for (i = 0; i < SMP_LOAD_TASKS; i++) {
+    status = smp_task_start (rtems_build_name ('L', 'D', '0' + i, ' '), SMP_LOAD_PRIO, load_cpu (i),
+			     Task_Load, i);
+    if (status != RTEMS_SUCCESSFUL)
+      printf ("load task %lu failed with status: %d\n", (unsigned long)i, status);
+  }
+
+  status = smp_task_start (rtems_build_name ('S', 'M', 'P', 'R'), 250, n_cpus - 1, Task_SMP_Report, 0);
+  if (status != RTEMS_SUCCESSFUL)
+    printf ("report task failed with status: %d\n", status);
+}
+
+#endif /* SQUARE_SMP */
@@ -13,6 +13,12 @@
 #include <inttypes.h>
 #include <rtems.h>
 #include "rpi_gpio.h"
+#include "boot.h"
+#include "admit.h"
+
+/* Periods for the various tasks */
+#define PERIOD_TASK_RATE_MONOTONIC     100  // Hz
+#define PERIOD_TASK_HRT_US             250  // sub-tick, from the system timer
 
 /* functions */
 
@@ -32,6 +38,40 @@ rtems_task Task_Relative_Period(
   rtems_task_argument argument
 );
 
+rtems_task Task_HRT_Period(
+  rtems_task_argument argument
+);
+
+rtems_task Task_PWM_Output(
+  rtems_task_argument argument
+);
+
+void Square_Setup(void);
+void Square_Job(void *unused);
+
+void Benchmark_GPIO(void);
+
+#ifdef SQUARE_SMP
+// Scheduler per processor (RTEMS_SCHEDULER_PRIORITY_SMP,
+// rtems_scheduler_ident_by_processor()), RTEMS 5 API
+#if !defined(__RTEMS_MAJOR__) || __RTEMS_MAJOR__ < 5
+#error "SQUARE_SMP needs RTEMS 5 or later, this tree otherwise targets 4.11"
+#endif
+#ifndef RTEMS_SMP
+#error "SQUARE_SMP needs a BSP built with --enable-smp"
+#endif
+#define SMP_CPUS            4
+#ifndef SMP_LOAD_TASKS
+#define SMP_LOAD_TASKS      3   // periodic load tasks on cores 1 to 3
+#endif
+#if SMP_LOAD_TASKS > 8
+#error "at most 8 load tasks"
+#endif
+
+void SMP_Start(void);
+int SMP_Task_Set(admit_task_t *set);
+#endif
+
 /* global variables */
 
 /*
@@ -48,18 +88,93 @@ extern rtems_name Task_name[ 2 ];       /* array of task names */
 
 #define CONFIGURE_APPLICATION_NEEDS_CONSOLE_DRIVER
 #define CONFIGURE_APPLICATION_NEEDS_CLOCK_DRIVER
-#define CONFIGURE_APPLICATION_EXTRA_DRIVERS RPI_GPIO_DRIVER_TABLE_ENTRY
+#define CONFIGURE_APPLICATION_EXTRA_DRIVERS BOOT_GPIO_DRIVER_TABLE_ENTRY
 
+#ifdef SQUARE_HRT
+// square period comes from the system timer, the tick can stay coarse
+#define CONFIGURE_MICROSECONDS_PER_TICK     10000
+#else
 #define CONFIGURE_MICROSECONDS_PER_TICK     500   // NB: 10 and lower gives system failure for erc32 simulator
-
+#endif
+
+#if defined(SQUARE_LEAN) && defined(SQUARE_SMP)
+#error "SQUARE_LEAN is a uniprocessor profile"
+#endif
+
+#ifdef SQUARE_LEAN
+// Fast boot: exact object counts, stacks from a static pool instead of
+// the workspace, mini IMFS, no FP context for Init
+#ifdef GPIO_BENCH
+#define CONFIGURE_LIBIO_MAXIMUM_FILE_DESCRIPTORS 5  // stdio + the two bench devices
+#else
+#define CONFIGURE_LIBIO_MAXIMUM_FILE_DESCRIPTORS 4  // stdio + /dev/rpi_gpio
+#endif
+#define CONFIGURE_USE_MINIIMFS_AS_BASE_FILESYSTEM
+#define CONFIGURE_MAXIMUM_TASKS             3       // Init, square, rtlog
+
+#define CONFIGURE_TASK_STACK_ALLOCATOR      lean_stack_alloc
+#define CONFIGURE_TASK_STACK_DEALLOCATOR    lean_stack_free
+#define CONFIGURE_TASK_STACK_ALLOCATOR_AVOIDS_WORK_SPACE
+#else
 #define CONFIGURE_LIBIO_MAXIMUM_FILE_DESCRIPTORS 5
+#endif
 
+#if defined(SQUARE_SMP)
+#define CONFIGURE_MAXIMUM_TASKS             (5 + SMP_LOAD_TASKS)
+#elif !defined(SQUARE_LEAN)
 #define CONFIGURE_MAXIMUM_TASKS             10
+#endif
 
+// Needed by the rpi_gpio driver (waveform playback)
+#define CONFIGURE_MAXIMUM_TIMERS            1
+#define CONFIGURE_MAXIMUM_SEMAPHORES        1
+
+#if defined(SQUARE_SMP)
+#define CONFIGURE_EXTRA_TASK_STACKS         ((10 + 2 * SMP_LOAD_TASKS) * RTEMS_MINIMUM_STACK_SIZE)
+#elif !defined(SQUARE_LEAN)
 #define CONFIGURE_EXTRA_TASK_STACKS         (6 * RTEMS_MINIMUM_STACK_SIZE)
+#endif
+
+#ifdef GPIO_TRACE
+#define CONFIGURE_MAXIMUM_USER_EXTENSIONS   1
+#endif
 
 // Needed for RM Mangager
+#ifdef SQUARE_SMP
+#define CONFIGURE_MAXIMUM_PERIODS           (1 + SMP_LOAD_TASKS)
+#else
 #define CONFIGURE_MAXIMUM_PERIODS           1
+#endif
+
+#ifdef SQUARE_SMP
+// Partitioned: one priority scheduler per core, Init (and the square
+// task) on core 0, the other cores are optional so that fewer CPUs
+// still boot
+#define CONFIGURE_MAXIMUM_PROCESSORS        SMP_CPUS
+
+#define CONFIGURE_SCHEDULER_PRIORITY_SMP
+
+#ifdef CONFIGURE_INIT
+#include <rtems/scheduler.h>
+
+RTEMS_SCHEDULER_PRIORITY_SMP(cpu0, 256);
+RTEMS_SCHEDULER_PRIORITY_SMP(cpu1, 256);
+RTEMS_SCHEDULER_PRIORITY_SMP(cpu2, 256);
+RTEMS_SCHEDULER_PRIORITY_SMP(cpu3, 256);
+#endif
+
+#define CONFIGURE_SCHEDULER_TABLE_ENTRIES \
+  RTEMS_SCHEDULER_TABLE_PRIORITY_SMP(cpu0, rtems_build_name('C', 'P', 'U', '0')), \
+  RTEMS_SCHEDULER_TABLE_PRIORITY_SMP(cpu1, rtems_build_name('C', 'P', 'U', '1')), \
+  RTEMS_SCHEDULER_TABLE_PRIORITY_SMP(cpu2, rtems_build_name('C', 'P', 'U', '2')), \
+  RTEMS_SCHEDULER_TABLE_PRIORITY_SMP(cpu3, rtems_build_name('C', 'P', 'U', '3'))
+
+#define CONFIGURE_SCHEDULER_ASSIGNMENTS \
+  RTEMS_SCHEDULER_ASSIGN(0, RTEMS_SCHEDULER_ASSIGN_PROCESSOR_MANDATORY), \
+  RTEMS_SCHEDULER_ASSIGN(1, RTEMS_SCHEDULER_ASSIGN_PROCESSOR_OPTIONAL), \
+  RTEMS_SCHEDULER_ASSIGN(2, RTEMS_SCHEDULER_ASSIGN_PROCESSOR_OPTIONAL), \
+  RTEMS_SCHEDULER_ASSIGN(3, RTEMS_SCHEDULER_ASSIGN_PROCESSOR_OPTIONAL)
+#endif
 
 #define CONFIGURE_RTEMS_INIT_TASKS_TABLE
 
@@ -67,7 +182,9 @@ extern rtems_name Task_name[ 2 ];       /* array of task names */
 /* Needed for erc32 simulator.. */
 /* ..for using "CPU_usage_Dump", since it uses printf("%f") if your processor has floating points) */
 /* If you want to take away FP support (to avoid heavy context switch), you must rewrite CPU_usage_Dump instead */
+#ifndef SQUARE_LEAN
 #define CONFIGURE_INIT_TASK_ATTRIBUTES RTEMS_FLOATING_POINT
+#endif
 
 
 #include <rtems/confdefs.h>
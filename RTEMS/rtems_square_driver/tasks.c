@@ -9,13 +9,110 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <rtems/error.h>
+#include "rtlog.h"
 #include "rpi_gpio.h"
+#include "rpi_hrt.h"
+#include "wcet.h"
+
+#ifdef GPIO_TRACE
+#include "trace.h"
+#define TRACE_DUMP_PERIODS  1000  // healthy run dump, 10 s
+#else
+#define trace_event(_event, _id, _arg)
+#endif
+
+#ifndef BCM2708_PERI_BASE
+#define BCM2708_PERI_BASE    0x20000000  /* 0x3F000000 on RPi 2/3 */
+#endif
+#define ST_CLO *((volatile unsigned int *)(BCM2708_PERI_BASE + 0x3004)) // system timer, 1 MHz
 
 //volatile unsigned int *gpio = (unsigned int *)GPIO_BASE;
 int fd;
 
-// Periods for the various tasks
-#define PERIOD_TASK_RATE_MONOTONIC     100
+#define RELEASE_REPORT                 500 // periods
+
+// Release time against the BCM2835 free running timer: error of each
+// release from one period to the next, and cumulative drift from the
+// ideal schedule t0 + n * period
+typedef struct {
+  const char *name;
+  uint32_t period_us;
+  uint32_t t0;
+  uint32_t n;
+  int32_t  drift;
+  int32_t  min, max;
+} release_stats_t;
+
+static void release_stamp (release_stats_t *r)
+{
+  uint32_t now = ST_CLO;
+  int32_t err;
+
+  if (r->n == 0)
+    r->t0 = now;
+
+  err = (int32_t)(now - (r->t0 + r->n * r->period_us));
+
+  if (r->n) {
+    if (r->n == 1 || err - r->drift < r->min)
+      r->min = err - r->drift;
+    if (r->n == 1 || err - r->drift > r->max)
+      r->max = err - r->drift;
+  }
+
+  r->drift = err;
+  r->n++;
+
+  if (r->n == 1) {
+    boot_stamp (BOOT_FIRST_RELEASE);
+    boot_report ();
+  }
+
+  if (r->n % RELEASE_REPORT == 0)
+    RTLOG ("%s: %lu periods, release error [%ld, %ld] us, drift %ld us\n", r->name,
+	   r->n, r->min, r->max, r->drift);
+}
+
+static void release_init (release_stats_t *r, const char *name, rtems_interval period_interval)
+{
+  r->name = name;
+  r->period_us = period_interval * rtems_configuration_get_microseconds_per_tick();
+  r->n = 0;
+}
+
+//
+// Square wave job, the body of every periodic task below, also timed
+// by the admission check before the tasks start
+//
+void Square_Setup (void)
+{
+  if (fd > 0)
+    return;
+
+  if ((fd = open ("/dev/rpi_gpio", O_RDWR)) < 0) {
+    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
+    exit (1);
+  }
+
+  ioctl(fd, RPI_GPIO_OUT, 16);
+}
+
+void Square_Job (void *unused)
+{
+  static int level;
+
+  if (level == 0) {
+    trace_event (TRACE_IOCTL_CALL, 0, RPI_GPIO_SET);
+    ioctl (fd, RPI_GPIO_SET, 16);
+  }
+  else {
+    trace_event (TRACE_IOCTL_CALL, 0, RPI_GPIO_CLR);
+    ioctl (fd, RPI_GPIO_CLR, 16);
+  }
+  trace_event (TRACE_IOCTL_RET, 0, 0);
+
+  level ^= 1;
+}
 
 //
 // Rate Monotonic Scheduling
@@ -27,18 +124,15 @@ rtems_task Task_Rate_Monotonic_Period (rtems_task_argument unused)
   rtems_id          RM_period;
   uint32_t          count;
   rtems_interval    period_interval;
+  release_stats_t   rs;
+  static wcet_t     wc;
 
   period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
   count = 0;
 
   printf ("Period interval: %d tick(s)\n", (int)period_interval);
 
-  if ((fd = open ("/dev/rpi_gpio", O_RDWR)) < 0) {
-    fprintf (stderr, "open error => %d %s\n", errno, strerror(errno));
-    exit (1);
-  }
-
-  ioctl(fd, RPI_GPIO_OUT, 16);
+  Square_Setup ();
 
   // Init RMS
   my_period_name = rtems_build_name( 'P', 'E', 'R', '1' );
@@ -47,20 +141,184 @@ rtems_task Task_Rate_Monotonic_Period (rtems_task_argument unused)
     printf("RM failed with status: %d\n", status);
     exit(1);
   }
-  
+
+  release_init (&rs, "RM", period_interval);
+  wcet_init (&wc, "RM ioctl");
+
   while( 1 ) {
-    if (count % 2 == 0)
-    	status = ioctl (fd, RPI_GPIO_SET, 16);
-    else
-     	status = ioctl (fd, RPI_GPIO_CLR, 16);
+    wcet_start (&wc);
+    Square_Job (NULL);
+    wcet_stop (&wc);
 
+    if (count == 0)
+      boot_stamp (BOOT_FIRST_EDGE);
     count++;
 
     // Block until RM period has expired
     status = rtems_rate_monotonic_period (RM_period, period_interval);
+    trace_event (TRACE_RELEASE, RM_period, 0);
 
     // Overrun ?
-    if (status == RTEMS_TIMEOUT)
-      printf ("RM missed period !\n");
+    if (status == RTEMS_TIMEOUT) {
+      trace_event (TRACE_MISSED, RM_period, 0);
+#ifdef GPIO_TRACE
+      trace_freeze ();
+#endif
+      RTLOG ("RM missed period !\n");
+    }
+
+#ifdef GPIO_TRACE
+    if (count == TRACE_DUMP_PERIODS)
+      trace_freeze ();
+#endif
+
+    release_stamp (&rs);
+
+    if (count % RELEASE_REPORT == 0)
+      wcet_report (&wc);
+  }
+}
+
+//
+// Hardware square: the PWM block toggles the pin, the task programs it
+// once and leaves, no wakeup nor ioctl per edge. The edges follow the
+// PWM clock, the scheduler plays no part in the jitter.
+//
+#define SQUARE_PWM_GPIO      18  // PWM0 (ALT5), GPIO 16 has no PWM function
+
+rtems_task Task_PWM_Output (rtems_task_argument unused)
+{
+  rpi_gpio_pwm_t pwm;
+
+  Square_Setup ();
+
+  // same wave as the RM task, one edge per period
+  pwm.pin = SQUARE_PWM_GPIO;
+  pwm.freq = PERIOD_TASK_RATE_MONOTONIC / 2;
+  pwm.duty = 500;
+
+  if (ioctl (fd, RPI_GPIO_PWM, &pwm) < 0) {
+    fprintf (stderr, "PWM error => %d %s\n", errno, strerror(errno));
+    exit (1);
+  }
+
+  boot_stamp (BOOT_FIRST_EDGE);
+  boot_report ();
+  RTLOG ("PWM: GPIO %lu at %lu Hz (%lu asked), duty %lu/1000\n", pwm.pin, pwm.actual,
+	 pwm.freq, pwm.duty);
+
+  rtems_task_delete (RTEMS_SELF);
+}
+
+//
+// Absolute period: the next release is computed from the previous
+// one, not from the wake-up time. rtems_task_wake_when() only has a
+// one second resolution, so the absolute date is kept in ticks and
+// turned into a relative delay just before sleeping.
+//
+rtems_task Task_Absolute_Period (rtems_task_argument unused)
+{
+  rtems_interval    period_interval, next, now;
+  uint32_t          count;
+  release_stats_t   rs;
+
+  period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
+  count = 0;
+
+  Square_Setup ();
+
+  printf ("Absolute period interval: %d tick(s)\n", (int)period_interval);
+
+  release_init (&rs, "ABS", period_interval);
+  next = rtems_clock_get_ticks_since_boot();
+
+  while( 1 ) {
+    Square_Job (NULL);
+
+    if (count == 0)
+      boot_stamp (BOOT_FIRST_EDGE);
+    count++;
+
+    next += period_interval;
+    now = rtems_clock_get_ticks_since_boot();
+    if ((int32_t)(next - now) > 0)
+      rtems_task_wake_after (next - now);
+    else
+      RTLOG ("ABS missed period !\n");
+
+    release_stamp (&rs);
+  }
+}
+
+//
+// Relative period: sleep one period after the work, the work time and
+// the wake-up latency add up period after period
+//
+rtems_task Task_Relative_Period (rtems_task_argument unused)
+{
+  rtems_interval    period_interval;
+  uint32_t          count;
+  release_stats_t   rs;
+
+  period_interval = rtems_clock_get_ticks_per_second() / PERIOD_TASK_RATE_MONOTONIC;
+  count = 0;
+
+  Square_Setup ();
+
+  printf ("Relative period interval: %d tick(s)\n", (int)period_interval);
+
+  release_init (&rs, "REL", period_interval);
+
+  while( 1 ) {
+    Square_Job (NULL);
+
+    if (count == 0)
+      boot_stamp (BOOT_FIRST_EDGE);
+    count++;
+
+    rtems_task_wake_after (period_interval);
+
+    release_stamp (&rs);
+  }
+}
+
+//
+// Sub-tick period from the BCM2835 system timer compare channel
+//
+rtems_task Task_HRT_Period (rtems_task_argument unused)
+{
+  static rpi_hrt_timer_t timer;
+  rtems_status_code status;
+  rtems_event_set   events;
+  uint32_t          count;
+
+  count = 0;
+
+  printf ("HRT period: %d us\n", PERIOD_TASK_HRT_US);
+
+  Square_Setup ();
+
+  status = rpi_hrt_initialize ();
+  if( RTEMS_SUCCESSFUL != status ) {
+    printf("HRT failed with status: %d\n", status);
+    exit(1);
+  }
+
+  // first release in 1 ms, then every period, the OS tick is not involved
+  rpi_hrt_start (&timer, rpi_hrt_now () + 1000, PERIOD_TASK_HRT_US,
+		 rpi_hrt_release_task, (void *)rtems_task_self ());
+
+  while( 1 ) {
+    rtems_event_receive (RPI_HRT_EVENT, RTEMS_WAIT | RTEMS_EVENT_ANY, RTEMS_NO_TIMEOUT, &events);
+    if (count == 0)
+      boot_stamp (BOOT_FIRST_RELEASE);
+
+    Square_Job (NULL);
+
+    if (count == 0) {
+      boot_stamp (BOOT_FIRST_EDGE);
+      boot_report ();
+    }
+    count++;
   }
 }
@@ -0,0 +1,104 @@
+/*
+ * Scheduling latency trace for RPi
+ *
+ * trace_dump() prints one record per line, feed the output to
+ * trace2timeline.py on the host
+ */
+#ifdef GPIO_TRACE
+
+#include <rtems.h>
+#include <stdio.h>
+#include "cycles.h"
+#include "trace.h"
+#include "rtlog.h"
+
+static trace_rec_t trace_buf[TRACE_SIZE];
+static uint32_t trace_head;
+static volatile int trace_on;
+static volatile int trace_frozen;
+
+RTEMS_INTERRUPT_LOCK_DEFINE(static, trace_lock, "trace")
+
+void trace_event(int event, uint32_t id, int arg)
+{
+  rtems_interrupt_lock_context lock_context;
+  trace_rec_t *r;
+
+  if (!trace_on)
+    return;
+
+  rtems_interrupt_lock_acquire(&trace_lock, &lock_context);
+  r = &trace_buf[trace_head++ % TRACE_SIZE];
+  r->cycles = cycles_read();
+  r->event = event;
+  r->arg = arg;
+  r->id = id;
+  rtems_interrupt_lock_release(&trace_lock, &lock_context);
+}
+
+// Context switch user extension
+static void trace_switch(rtems_tcb *executing, rtems_tcb *heir)
+{
+  trace_event(TRACE_SWITCH, heir->Object.id, rtems_object_id_get_index(executing->Object.id));
+}
+
+// Clock tick ISR, linked with -Wl,--wrap=rtems_clock_tick
+rtems_status_code __real_rtems_clock_tick(void);
+
+rtems_status_code __wrap_rtems_clock_tick(void)
+{
+  rtems_status_code status;
+
+  trace_event(TRACE_TICK_ENTRY, 0, 0);
+  status = __real_rtems_clock_tick();
+  trace_event(TRACE_TICK_EXIT, 0, 0);
+
+  return status;
+}
+
+void trace_init(void)
+{
+  static rtems_extensions_table ext = {
+    .thread_switch = trace_switch
+  };
+  rtems_id ext_id;
+  rtems_status_code status;
+
+  cycles_init();
+
+  status = rtems_extension_create(rtems_build_name('T', 'R', 'C', 'E'), &ext, &ext_id);
+  if (status != RTEMS_SUCCESSFUL)
+    printf("trace: extension failed with status: %d\n", status);
+
+  trace_on = 1;
+}
+
+void trace_freeze(void)
+{
+  trace_on = 0;
+
+  // one dump only, the buffer does not change anymore
+  if (__sync_lock_test_and_set(&trace_frozen, 1) == 0)
+    rtlog_call(trace_dump);
+}
+
+// Oldest record first, about TRACE_SIZE lines on the console
+void trace_dump(void)
+{
+  uint32_t i, n, first;
+  trace_rec_t *r;
+
+  trace_on = 0;
+
+  n = (trace_head < TRACE_SIZE ? trace_head : TRACE_SIZE);
+  first = trace_head - n;
+
+  printf("# trace cpu_hz=%lu records=%lu\n", (unsigned long)TRACE_CPU_HZ, (unsigned long)n);
+  for (i = 0; i < n; i++) {
+    r = &trace_buf[(first + i) % TRACE_SIZE];
+    printf("T %08lx %d %08lx %d\n", (unsigned long)r->cycles, r->event, (unsigned long)r->id, r->arg);
+  }
+  printf("# end\n");
+}
+
+#endif /* GPIO_TRACE */
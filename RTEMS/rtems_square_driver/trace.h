@@ -0,0 +1,50 @@
+/*
+ * Scheduling latency trace for RPi
+ *
+ * Post-mortem ring buffer of cycle-stamped events: context switches,
+ * clock tick ISR, period releases, GPIO ISR and driver entry/exit
+ */
+#ifndef __TRACE_h
+#define __TRACE_h
+
+#include <rtems.h>
+
+/* Events */
+#define TRACE_SWITCH       1   /* id = heir task, arg = index of previous task */
+#define TRACE_TICK_ENTRY   2   /* clock tick ISR, needs --wrap=rtems_clock_tick */
+#define TRACE_TICK_EXIT    3
+#define TRACE_RELEASE      4   /* task back from rtems_rate_monotonic_period */
+#define TRACE_ISR_ENTRY    5   /* GPIO ISR */
+#define TRACE_ISR_EXIT     6
+#define TRACE_DRV_ENTRY    7   /* rpi_gpio_control(), arg = cmd */
+#define TRACE_DRV_EXIT     8
+#define TRACE_IOCTL_CALL   9   /* application side of ioctl(), arg = cmd */
+#define TRACE_IOCTL_RET    10
+#define TRACE_MISSED       11  /* RM missed period */
+
+#define TRACE_SIZE         4096 /* records, power of 2 */
+
+#ifndef TRACE_CPU_HZ
+#define TRACE_CPU_HZ       700000000
+#endif
+
+typedef struct {
+  uint32_t cycles;
+  uint8_t  event;
+  uint8_t  reserved;
+  uint16_t arg;
+  uint32_t id;
+} trace_rec_t;
+
+void trace_init(void);
+void trace_event(int event, uint32_t id, int arg);
+/*
+ * trace_freeze() stops the recording, the first call has the buffer
+ * printed by the rtlog task and returns at once: real-time tasks call
+ * it, never trace_dump().
+ */
+void trace_freeze(void);
+void trace_dump(void);
+
+#endif
+/* end of include file */
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+#
+# Turn a trace_dump() console capture into a timeline and
+# release-to-run latency percentiles
+#
+# usage: trace2timeline.py [-p period_ticks] [-t] console.log
+#
+import sys
+import getopt
+
+EVENTS = {
+    1: "SWITCH", 2: "TICK_ENTRY", 3: "TICK_EXIT", 4: "RELEASE",
+    5: "ISR_ENTRY", 6: "ISR_EXIT", 7: "DRV_ENTRY", 8: "DRV_EXIT",
+    9: "IOCTL_CALL", 10: "IOCTL_RET", 11: "MISSED",
+}
+
+
+def usage():
+    sys.stderr.write("usage: %s [-p period_ticks] [-t] console.log\n" % sys.argv[0])
+    sys.exit(1)
+
+
+def load(f):
+    cpu_hz = 700000000
+    recs = []
+    last = None
+    high = 0
+
+    for line in f:
+        line = line.strip()
+        if line.startswith("# trace"):
+            for kv in line.split()[2:]:
+                k, v = kv.split("=")
+                if k == "cpu_hz":
+                    cpu_hz = int(v)
+            recs = []
+            last = None
+            high = 0
+        elif line.startswith("T "):
+            _, cycles, event, rid, arg = line.split()
+            c = int(cycles, 16)
+            # 32-bit counter, records are less than one wrap apart
+            if last is not None and c < last:
+                high += 1 << 32
+            last = c
+            recs.append((high + c, int(event), int(rid, 16), int(arg)))
+
+    return cpu_hz, recs
+
+
+def percentiles(name, values):
+    if not values:
+        print("%-22s no samples" % name)
+        return
+    v = sorted(values)
+    n = len(v)
+
+    def pct(p):
+        return v[min(n - 1, int(p * n / 100))]
+
+    print("%-22s n=%-6d min=%8.2f p50=%8.2f p90=%8.2f p99=%8.2f max=%8.2f us"
+          % (name, n, v[0], pct(50), pct(90), pct(99), v[-1]))
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "p:t")
+    except getopt.GetoptError:
+        usage()
+
+    # 10 ms period with a 500 us tick
+    period_ticks = 20
+    timeline = False
+    for o, a in opts:
+        if o == "-p":
+            period_ticks = int(a)
+        elif o == "-t":
+            timeline = True
+
+    if len(args) != 1:
+        usage()
+
+    with open(args[0]) as f:
+        cpu_hz, recs = load(f)
+
+    if not recs:
+        sys.stderr.write("no trace records found\n")
+        sys.exit(1)
+
+    def us(c):
+        return (c - recs[0][0]) * 1e6 / cpu_hz
+
+    # tick times, to find the tick that released each period
+    ticks = []
+    release_lat = []
+    ioctl_lat = []
+    drv_lat = []
+    isr_lat = []
+    expected = {}
+    t_call = t_drv = t_isr = None
+
+    for c, event, rid, arg in recs:
+        if timeline:
+            print("%12.2f %-10s id=%08x arg=%d" % (us(c), EVENTS.get(event, event), rid, arg))
+
+        if event == 2:
+            ticks.append(c)
+        elif event == 4 and ticks:
+            # the releasing tick is period_ticks after the previous one,
+            # the latest tick for the first release
+            k = expected.get(rid, len(ticks) - 1)
+            if k < len(ticks):
+                release_lat.append((c - ticks[k]) * 1e6 / cpu_hz)
+            expected[rid] = k + period_ticks
+        elif event == 9:
+            t_call = c
+        elif event == 10 and t_call is not None:
+            ioctl_lat.append((c - t_call) * 1e6 / cpu_hz)
+            t_call = None
+        elif event == 7:
+            t_drv = c
+        elif event == 8 and t_drv is not None:
+            drv_lat.append((c - t_drv) * 1e6 / cpu_hz)
+            t_drv = None
+        elif event == 5:
+            t_isr = c
+        elif event == 6 and t_isr is not None:
+            isr_lat.append((c - t_isr) * 1e6 / cpu_hz)
+            t_isr = None
+
+    print("%d records, %.2f ms, cpu %d Hz" % (len(recs), us(recs[-1][0]) / 1000, cpu_hz))
+    percentiles("release to run", release_lat)
+    percentiles("ioctl() total", ioctl_lat)
+    percentiles("driver control", drv_lat)
+    percentiles("GPIO ISR", isr_lat)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,41 @@
+/*
+ * Per-iteration execution time of periodic loops for RPi
+ */
+#include <rtems.h>
+#include <string.h>
+#include "rtlog.h"
+#include "wcet.h"
+
+void wcet_init(wcet_t *w, const char *name)
+{
+  uint32_t c;
+  int i;
+
+  memset(w, 0, sizeof (*w));
+  w->name = name;
+
+  // cost of the measurement itself, taken off every run
+  w->overhead = 0xffffffff;
+  for (i = 0; i < 8; i++) {
+    c = cycles_read();
+    c = cycles_read() - c;
+    if (c < w->overhead)
+      w->overhead = c;
+  }
+}
+
+// Summary line, then one line per non-empty bucket
+void wcet_report(const wcet_t *w)
+{
+  int k;
+
+  if (w->n == 0)
+    return;
+
+  RTLOG ("%s: %lu runs, cycles min %lu avg %lu max %lu\n", w->name, w->n, w->min,
+	 (uint32_t)(w->sum / w->n), w->max);
+
+  for (k = 0; k < WCET_BUCKETS; k++)
+    if (w->hist[k])
+      RTLOG ("%s:   %10lu.. cycles %8lu\n", w->name, k ? 1u << k : 0, w->hist[k]);
+}
@@ -0,0 +1,63 @@
+/*
+ * Per-iteration execution time of periodic loops for RPi
+ *
+ * wcet_start() / wcet_stop() around the loop body read the ARM cycle
+ * counter and update min/max/sum and a log2 histogram (bucket k counts
+ * the runs of 2^k to 2^(k+1) - 1 cycles). No allocation, no lock: one
+ * wcet_t per task, only updated and reported by its own task.
+ * wcet_report() goes through rtlog.
+ *
+ * The cycle counter must have been started with cycles_init(), under
+ * QEMU it does not count and every run is 0.
+ */
+#ifndef __WCET_h
+#define __WCET_h
+
+#include <stdint.h>
+#include "cycles.h"
+
+#define WCET_BUCKETS   32
+
+typedef struct {
+  const char *name;
+  uint32_t start;
+  uint32_t overhead;    /* cycles of a back-to-back counter read */
+  uint32_t n;
+  uint32_t min, max;
+  uint64_t sum;
+  uint32_t hist[WCET_BUCKETS];
+} wcet_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void wcet_init(wcet_t *w, const char *name);
+void wcet_report(const wcet_t *w);
+
+static inline void wcet_start(wcet_t *w)
+{
+  w->start = cycles_read();
+}
+
+static inline void wcet_stop(wcet_t *w)
+{
+  uint32_t c = cycles_read() - w->start;
+
+  c = (c > w->overhead ? c - w->overhead : 0);
+
+  if (w->n == 0 || c < w->min)
+    w->min = c;
+  if (c > w->max)
+    w->max = c;
+  w->sum += c;
+  w->n++;
+  w->hist[31 - __builtin_clz(c | 1)]++;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* end of include file */
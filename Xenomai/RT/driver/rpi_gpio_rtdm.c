@@ -4,6 +4,11 @@
 #include <linux/module.h>
 #include <rtdm/rtdm_driver.h>
 #include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/fcntl.h>
+#include <asm/div64.h>
+#include "rpi_gpio_rtdm.h"
 
 #define RTDM_SUBCLASS_RPI_GPIO       0
 #define DEVICE_NAME                 "rpi_gpio"
@@ -15,11 +20,7 @@ MODULE_AUTHOR("Pierre Ficheux");
 #define BCM2708_PERI_BASE        0x20000000
 #define GPIO_BASE                (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
 
-// GPIO setup macros. Always use INP_GPIO(x) before using OUT_GPIO(x) 
-// or SET_GPIO_ALT(x,y)
-#define INP_GPIO(addr,g) *((addr)+((g)/10)) &= ~(7<<(((g)%10)*3))
-#define OUT_GPIO(addr,g) *((addr)+((g)/10)) |=  (1<<(((g)%10)*3))
-
+#define GPIO_FSEL(gpio,k) *((gpio)+(k)) // GPFSEL0-5, only written, see fsel_shadow
 #define GPIO_SET(gpio) *((gpio)+7)  // sets   bits which are 1 ignores bits which are 0
 #define GPIO_CLR(gpio) *((gpio)+10) // clears bits which are 1 ignores bits which are 0
 
@@ -28,45 +29,637 @@ unsigned long *virt_addr;
 static int debug;
 static int gpio_nr = 25;
 
+// Pulse end: timer this early, then busy-wait with IRQs off, so the
+// spin is bounded by PULSE_MARGIN_MAX whatever the parameter says
+#define PULSE_MARGIN_MAX  50000
+static unsigned int pulse_margin = 20000;
+
 module_param(debug, int, 0644);
-module_param(gpio_nr, int, 0644);
+module_param(gpio_nr, int, 0444);
+module_param(pulse_margin, uint, 0644);
+
+// Pins bound to an fd, one bit per GPIO, updated with cmpxchg only
+static unsigned long gpio_owned;
+
+// GPFSEL words are shared by 10 pins, possibly of different fds.
+// fsel_shadow is their copy, loaded once at init: the words are built
+// from it and only stored when they change, never read back.
+static rtdm_lock_t fsel_lock;
+static uint32_t fsel_shadow[RPI_GPIO_FSEL_WORDS];
 
 struct rpi_gpio_context {
   unsigned long *gpio_addr;
-  int gpio_nr;
+  volatile unsigned long *set_reg;  // GPSET0 / GPCLR0, precomputed
+  volatile unsigned long *clr_reg;
+  unsigned long mask;               // pins driven by this fd
+  unsigned long owned;              // pins claimed by this fd
+  int nonblock;
+
+  // Timed commands, head moved by write() and tail by the timer
+  struct rpi_gpio_cmd queue[RPI_GPIO_QUEUE_LEN];
+  unsigned int head, tail;
+  int armed;
+  rtdm_lock_t lock;
+  rtdm_timer_t timer;
+  rtdm_event_t space;               // signaled when commands are run
+  struct rpi_gpio_queue_stats stats;
+  uint64_t latency_sum;
+  uint64_t last_time;               // of the last command queued
+
+  // Pulse in progress, RTDM clock at the set and at the end
+  rtdm_timer_t pulse_timer;
+  unsigned long pulse_mask;
+  nanosecs_abs_t pulse_start, pulse_end;
+  uint32_t pulse_width;
+  int pulse_busy;
+  struct rpi_gpio_pulse_info pulse_info;
+  uint64_t pulse_error_sum;
+
+  // Output latch, set/clr masks pending until the next commit
+  rtdm_timer_t latch_timer;
+  int latch_mode;
+  unsigned long latch_set, latch_clr;
+  struct rpi_gpio_latch_stats latch_stats;
 };
 
+static int pins_claim(unsigned long mask)
+{
+  unsigned long old;
+
+  do {
+    old = gpio_owned;
+    if (old & mask)
+      return -EBUSY;
+  } while (cmpxchg(&gpio_owned, old, old | mask) != old);
+
+  return 0;
+}
+
+static void pins_release(unsigned long mask)
+{
+  unsigned long old;
+
+  do {
+    old = gpio_owned;
+  } while (cmpxchg(&gpio_owned, old, old & ~mask) != old);
+}
+
+// Set the pins of mask to func[pin] (output if func is NULL), the six
+// words in one pass. Returns the GPFSEL stores done.
+static int fsel_apply(uint64_t mask, const uint8_t *func)
+{
+  rtdm_lockctx_t lock_ctx;
+  uint32_t w, f;
+  int k, shift, g, n = 0;
+
+  rtdm_lock_get_irqsave(&fsel_lock, lock_ctx);
+  for (k = 0, g = 0; k < RPI_GPIO_FSEL_WORDS; k++) {
+    w = fsel_shadow[k];
+    for (shift = 0; shift < 30 && g < RPI_GPIO_FSEL_PINS; shift += 3, g++) {
+      if (mask & (1ULL << g)) {
+	f = (func ? func[g] : RPI_GPIO_FSEL_OUT);
+	w = (w & ~(7 << shift)) | (f << shift);
+      }
+    }
+    if (w != fsel_shadow[k]) {
+      fsel_shadow[k] = w;
+      GPIO_FSEL(virt_addr, k) = w;
+      n++;
+    }
+  }
+  rtdm_lock_put_irqrestore(&fsel_lock, lock_ctx);
+
+  return n;
+}
+
+static int rpi_gpio_bind(struct rpi_gpio_context *ctx, unsigned long mask)
+{
+  int err;
+
+  // the module pin is driven by every unbound fd, it is never bound
+  if (mask & (1UL << gpio_nr))
+    return -EBUSY;
+
+  if (mask & ~ctx->owned) {
+    // new pins only, the ones kept stay claimed
+    err = pins_claim(mask & ~ctx->owned);
+    if (err)
+      return err;
+    fsel_apply(mask & ~ctx->owned, NULL);
+  }
+
+  pins_release(ctx->owned & ~mask);
+  ctx->owned = mask;
+  ctx->mask = (mask ? mask : (1UL << gpio_nr));
+
+  if (debug)
+    rtdm_printk("RPI_GPIO RTDM, fd bound to 0x%08lx, owned 0x%08lx\n", mask, gpio_owned);
+
+  return 0;
+}
+
+// Run the commands due, then arm the timer for the next one, called
+// with ctx->lock held
+static void queue_run(struct rpi_gpio_context *ctx, int in_handler)
+{
+  struct rpi_gpio_cmd *c;
+  nanosecs_abs_t now;
+  uint32_t lat;
+  int err;
+
+  while (ctx->tail != ctx->head) {
+    now = rtdm_clock_read_monotonic();
+
+    while (ctx->tail != ctx->head) {
+      c = &ctx->queue[ctx->tail % RPI_GPIO_QUEUE_LEN];
+      if (c->time > now)
+	break;
+
+      *ctx->set_reg = c->set;
+      *ctx->clr_reg = c->clr;
+
+      lat = (uint32_t)min_t(uint64_t, now - c->time, 0xffffffff);
+      if (lat > ctx->stats.max_latency)
+	ctx->stats.max_latency = lat;
+      ctx->latency_sum += lat;
+      ctx->stats.done++;
+      ctx->tail++;
+    }
+
+    if (ctx->tail == ctx->head)
+      break;
+
+    // a date already past is refused, run it now
+    c = &ctx->queue[ctx->tail % RPI_GPIO_QUEUE_LEN];
+    if (in_handler)
+      err = rtdm_timer_start_in_handler(&ctx->timer, c->time, 0, RTDM_TIMERMODE_ABSOLUTE);
+    else
+      err = rtdm_timer_start(&ctx->timer, c->time, 0, RTDM_TIMERMODE_ABSOLUTE);
+    if (err == 0) {
+      ctx->armed = 1;
+      return;
+    }
+  }
+
+  ctx->armed = 0;
+}
+
+// Busy-wait for the end of the pulse, clear the pins and account for
+// the width achieved
+static void pulse_end(struct rpi_gpio_context *ctx)
+{
+  struct rpi_gpio_pulse_info *pi = &ctx->pulse_info;
+  uint32_t width, error;
+
+  // fixed rate clock, the same on every CPU whatever the ARM frequency
+  if (rtdm_clock_read_monotonic() > ctx->pulse_end)
+    pi->late++;
+  while (rtdm_clock_read_monotonic() < ctx->pulse_end)
+    ;
+  *ctx->clr_reg = ctx->pulse_mask;
+  width = (uint32_t)(rtdm_clock_read_monotonic() - ctx->pulse_start);
+
+  error = (width > ctx->pulse_width ? width - ctx->pulse_width : 0);
+  pi->count++;
+  pi->last_width = width;
+  if (error > pi->max_error)
+    pi->max_error = error;
+  ctx->pulse_error_sum += error;
+  ctx->pulse_busy = 0;
+}
+
+static void rpi_gpio_pulse_timer(rtdm_timer_t *timer)
+{
+  struct rpi_gpio_context *ctx = container_of(timer, struct rpi_gpio_context, pulse_timer);
+  rtdm_lockctx_t lock_ctx;
+
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  // nothing left to do if close() ended the pulse
+  if (ctx->pulse_busy)
+    pulse_end(ctx);
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+}
+
+static uint32_t pulse_margin_ns(void)
+{
+  uint32_t margin = pulse_margin;
+
+  return (margin > PULSE_MARGIN_MAX ? PULSE_MARGIN_MAX : margin);
+}
+
+static int pulse_start(struct rpi_gpio_context *ctx, const struct rpi_gpio_pulse *p)
+{
+  rtdm_lockctx_t lock_ctx;
+  uint32_t margin = pulse_margin_ns();
+  int err = 0;
+
+  // achieved widths are reported in 32-bit ns
+  if (p->width > 1000000000)
+    return -EINVAL;
+
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  if (ctx->pulse_busy) {
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    return -EBUSY;
+  }
+
+  ctx->pulse_mask = p->mask & ctx->mask;
+  ctx->pulse_width = p->width;
+  ctx->pulse_busy = 1;
+
+  ctx->pulse_start = rtdm_clock_read_monotonic();
+  *ctx->set_reg = ctx->pulse_mask;
+  ctx->pulse_end = ctx->pulse_start + p->width;
+
+  // short pulse spins here, at most PULSE_MARGIN_MAX. The timer date
+  // is ahead of the set, it is only refused on error: no spin then,
+  // the pins are cleared at once.
+  if (p->width <= margin)
+    pulse_end(ctx);
+  else if ((err = rtdm_timer_start(&ctx->pulse_timer, ctx->pulse_end - margin, 0, RTDM_TIMERMODE_ABSOLUTE))) {
+    *ctx->clr_reg = ctx->pulse_mask;
+    ctx->pulse_busy = 0;
+  }
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+  return err;
+}
+
+// Net change since the previous commit, called with ctx->lock held
+static void latch_commit(struct rpi_gpio_context *ctx)
+{
+  if (ctx->latch_set) {
+    *ctx->set_reg = ctx->latch_set;
+    ctx->latch_stats.stores++;
+  }
+  if (ctx->latch_clr) {
+    *ctx->clr_reg = ctx->latch_clr;
+    ctx->latch_stats.stores++;
+  }
+
+  ctx->latch_set = ctx->latch_clr = 0;
+  ctx->latch_stats.commits++;
+}
+
+static void rpi_gpio_latch_timer(rtdm_timer_t *timer)
+{
+  struct rpi_gpio_context *ctx = container_of(timer, struct rpi_gpio_context, latch_timer);
+  rtdm_lockctx_t lock_ctx;
+
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  latch_commit(ctx);
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+}
+
+// Store now, or only in the latch, the last request wins on a pin
+static void pins_write(struct rpi_gpio_context *ctx, unsigned long set, unsigned long clr)
+{
+  rtdm_lockctx_t lock_ctx;
+
+  // mode read under the lock, a request racing with RPI_GPIO_LATCH
+  // OFF is either stored or latched before the final commit
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  if (ctx->latch_mode == RPI_GPIO_LATCH_OFF) {
+    if (set)
+      *ctx->set_reg = set;
+    if (clr)
+      *ctx->clr_reg = clr;
+  }
+  else {
+    ctx->latch_set = (ctx->latch_set & ~clr) | set;
+    ctx->latch_clr = (ctx->latch_clr & ~set) | clr;
+    ctx->latch_stats.requests++;
+  }
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+}
+
+static int latch_setup(struct rpi_gpio_context *ctx, const struct rpi_gpio_latch *l)
+{
+  rtdm_lockctx_t lock_ctx;
+  int err = 0;
+
+  if (l->mode > RPI_GPIO_LATCH_AUTO || (l->mode == RPI_GPIO_LATCH_AUTO && l->period == 0))
+    return -EINVAL;
+
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  rtdm_timer_stop(&ctx->latch_timer);
+  if (ctx->latch_mode != RPI_GPIO_LATCH_OFF)
+    latch_commit(ctx);
+
+  ctx->latch_mode = l->mode;
+  if (l->mode == RPI_GPIO_LATCH_AUTO) {
+    err = rtdm_timer_start(&ctx->latch_timer, l->start, l->period, RTDM_TIMERMODE_REALTIME);
+    if (err)
+      ctx->latch_mode = RPI_GPIO_LATCH_OFF;
+  }
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+  return err;
+}
+
+static void rpi_gpio_timer(rtdm_timer_t *timer)
+{
+  struct rpi_gpio_context *ctx = container_of(timer, struct rpi_gpio_context, timer);
+  rtdm_lockctx_t lock_ctx;
+
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  queue_run(ctx, 1);
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+  rtdm_event_signal(&ctx->space);
+}
+
+static int copy_in(rtdm_user_info_t *user_info, void *dst, const void __user *src, size_t size)
+{
+  if (user_info)
+    return rtdm_safe_copy_from_user(user_info, dst, src, size);
+
+  memcpy(dst, src, size);
+  return 0;
+}
+
+static int copy_out(rtdm_user_info_t *user_info, void __user *dst, const void *src, size_t size)
+{
+  if (user_info)
+    return rtdm_safe_copy_to_user(user_info, dst, src, size);
+
+  memcpy(dst, src, size);
+  return 0;
+}
+
+// Pins 0-31 of the request must not be bound to another fd
+static int rpi_gpio_config(struct rpi_gpio_context *ctx, rtdm_user_info_t *user_info, const void __user *arg)
+{
+  struct rpi_gpio_config cfg;
+  int err, g;
+
+  err = copy_in(user_info, &cfg, arg, sizeof(cfg));
+  if (err)
+    return err;
+
+  if (cfg.mask >> RPI_GPIO_FSEL_PINS)
+    return -EINVAL;
+  for (g = 0; g < RPI_GPIO_FSEL_PINS; g++)
+    if ((cfg.mask & (1ULL << g)) && cfg.func[g] > 7)
+      return -EINVAL;
+
+  if ((unsigned long)cfg.mask & gpio_owned & ~ctx->owned)
+    return -EBUSY;
+
+  return fsel_apply(cfg.mask, cfg.func);
+}
+
 int rpi_gpio_open(struct rtdm_dev_context *context, rtdm_user_info_t *user_info, int oflags)
 {
   struct rpi_gpio_context *ctx;
+  int err;
   
   ctx = (struct rpi_gpio_context *) context->dev_private;
   ctx->gpio_addr = virt_addr;
-  ctx->gpio_nr = gpio_nr;
+  ctx->set_reg = &GPIO_SET(virt_addr);
+  ctx->clr_reg = &GPIO_CLR(virt_addr);
+
+  // unbound: the module pin, shared by every unbound fd
+  ctx->mask = (1UL << gpio_nr);
+  ctx->owned = 0;
+
+  // no store at all once the pin is an output
+  fsel_apply(ctx->mask, NULL);
+
+  ctx->nonblock = (oflags & O_NONBLOCK) != 0;
+  ctx->head = ctx->tail = 0;
+  ctx->armed = 0;
+  memset(&ctx->stats, 0, sizeof(ctx->stats));
+  ctx->latency_sum = 0;
+  ctx->last_time = 0;
+  rtdm_lock_init(&ctx->lock);
+  rtdm_event_init(&ctx->space, 0);
+
+  ctx->pulse_busy = 0;
+  memset(&ctx->pulse_info, 0, sizeof(ctx->pulse_info));
+  ctx->pulse_error_sum = 0;
+
+  ctx->latch_mode = RPI_GPIO_LATCH_OFF;
+  ctx->latch_set = ctx->latch_clr = 0;
+  memset(&ctx->latch_stats, 0, sizeof(ctx->latch_stats));
 
-  OUT_GPIO(ctx->gpio_addr, ctx->gpio_nr);
+  err = rtdm_timer_init(&ctx->timer, rpi_gpio_timer, "rpi_gpio");
+  if (err)
+    return err;
+
+  err = rtdm_timer_init(&ctx->pulse_timer, rpi_gpio_pulse_timer, "rpi_gpio_pulse");
+  if (err)
+    goto fail_pulse;
+
+  err = rtdm_timer_init(&ctx->latch_timer, rpi_gpio_latch_timer, "rpi_gpio_latch");
+  if (err)
+    goto fail_latch;
 
   return 0;
+
+ fail_latch:
+  rtdm_timer_destroy(&ctx->pulse_timer);
+ fail_pulse:
+  rtdm_timer_destroy(&ctx->timer);
+
+  return err;
 }
 
 int rpi_gpio_close(struct rtdm_dev_context *context, rtdm_user_info_t *user_info)
 {
+  struct rpi_gpio_context *ctx = (struct rpi_gpio_context *) context->dev_private;
+  rtdm_lockctx_t lock_ctx;
+
+  // a pulse in progress ends now, its pins are not left driven high
+  rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+  rtdm_timer_stop(&ctx->pulse_timer);
+  if (ctx->pulse_busy) {
+    *ctx->clr_reg = ctx->pulse_mask;
+    ctx->pulse_busy = 0;
+  }
+  rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+  rtdm_timer_destroy(&ctx->timer);
+  rtdm_timer_destroy(&ctx->pulse_timer);
+  rtdm_timer_destroy(&ctx->latch_timer);
+  rtdm_event_destroy(&ctx->space);
+
+  pins_release(ctx->owned);
+  ctx->owned = 0;
+
   return 0;
 }
 
+static ssize_t rpi_gpio_write_rt(struct rtdm_dev_context *context, rtdm_user_info_t *user_info, const void *buf, size_t nbyte)
+{
+  struct rpi_gpio_context *ctx = (struct rpi_gpio_context *) context->dev_private;
+  const struct rpi_gpio_cmd __user *ucmd = buf;
+  struct rpi_gpio_cmd cmd, *c;
+  rtdm_lockctx_t lock_ctx;
+  size_t n, done;
+  int err = 0;
+
+  n = nbyte / sizeof(cmd);
+  if (n == 0)
+    return -EINVAL;
+
+  for (done = 0; done < n; done++) {
+    err = copy_in(user_info, &cmd, &ucmd[done], sizeof(cmd));
+    if (err)
+      break;
+
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    while (ctx->head - ctx->tail == RPI_GPIO_QUEUE_LEN) {
+      rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+      if (ctx->nonblock)
+	goto out;
+      err = rtdm_event_wait(&ctx->space);
+      if (err)
+	goto out;
+
+      rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    }
+
+    // the queue is run in order
+    if (cmd.time < ctx->last_time) {
+      rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+      err = -EINVAL;
+      break;
+    }
+    ctx->last_time = cmd.time;
+
+    c = &ctx->queue[ctx->head % RPI_GPIO_QUEUE_LEN];
+    c->time = cmd.time;
+    c->set = cmd.set & ctx->mask;
+    c->clr = cmd.clr & ctx->mask;
+    ctx->head++;
+
+    ctx->stats.queued++;
+    if (cmd.time <= rtdm_clock_read_monotonic())
+      ctx->stats.past++;
+
+    if (!ctx->armed)
+      queue_run(ctx, 0);
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+  }
+
+ out:
+  if (done == 0)
+    return (ctx->nonblock && !err) ? -EAGAIN : err;
+
+  return done * sizeof(cmd);
+}
+
 static ssize_t rpi_gpio_ioctl_rt(struct rtdm_dev_context* context, rtdm_user_info_t* user_info, unsigned int request, void __user* arg)
 {
   struct rpi_gpio_context *ctx = (struct rpi_gpio_context *) context->dev_private;
-  
-  // Set or Clear
-  if (request == 0)
-    GPIO_SET(ctx->gpio_addr) = (1 << ctx->gpio_nr);
-  else
-    GPIO_CLR(ctx->gpio_addr) = (1 << ctx->gpio_nr);
+  struct rpi_gpio_queue_stats stats;
+  struct rpi_gpio_pulse pulse;
+  struct rpi_gpio_pulse_info pulse_info;
+  struct rpi_gpio_latch latch;
+  struct rpi_gpio_latch_stats latch_stats;
+  rtdm_lockctx_t lock_ctx;
+  uint64_t sum;
+  int err;
+
+  switch (request) {
+  case RPI_GPIO_SET :
+    pins_write(ctx, ctx->mask, 0);
+    break;
+
+  case RPI_GPIO_CLR :
+    pins_write(ctx, 0, ctx->mask);
+    break;
+
+  case RPI_GPIO_SET_PINS :
+    pins_write(ctx, (unsigned long)arg & ctx->mask, 0);
+    break;
+
+  case RPI_GPIO_CLR_PINS :
+    pins_write(ctx, 0, (unsigned long)arg & ctx->mask);
+    break;
+
+  case RPI_GPIO_LATCH :
+    err = copy_in(user_info, &latch, arg, sizeof(latch));
+    if (err)
+      return err;
+    return latch_setup(ctx, &latch);
+
+  case RPI_GPIO_COMMIT :
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    latch_commit(ctx);
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    break;
+
+  case RPI_GPIO_LATCH_STATS :
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    latch_stats = ctx->latch_stats;
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    return copy_out(user_info, arg, &latch_stats, sizeof(latch_stats));
+
+  case RPI_GPIO_QUEUE_STATS :
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    stats = ctx->stats;
+    stats.pending = ctx->head - ctx->tail;
+    sum = ctx->latency_sum;
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    if (stats.done)
+      do_div(sum, stats.done);
+    stats.avg_latency = (uint32_t)sum;
+    return copy_out(user_info, arg, &stats, sizeof(stats));
+
+  case RPI_GPIO_PULSE :
+    err = copy_in(user_info, &pulse, arg, sizeof(pulse));
+    if (err)
+      return err;
+    return pulse_start(ctx, &pulse);
+
+  case RPI_GPIO_PULSE_INFO :
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    pulse_info = ctx->pulse_info;
+    sum = ctx->pulse_error_sum;
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    if (pulse_info.count)
+      do_div(sum, pulse_info.count);
+    pulse_info.avg_error = (uint32_t)sum;
+    pulse_info.margin = pulse_margin_ns();
+    return copy_out(user_info, arg, &pulse_info, sizeof(pulse_info));
+
+  case RPI_GPIO_QUEUE_FLUSH :
+    rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+    rtdm_timer_stop(&ctx->timer);
+    ctx->armed = 0;
+    ctx->tail = ctx->head;
+    ctx->last_time = 0;
+    rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+    rtdm_event_signal(&ctx->space);
+    break;
+
+  case RPI_GPIO_BIND :
+  case RPI_GPIO_CONFIG :
+    // GPFSEL setup, done in secondary mode
+    return -ENOSYS;
+
+  default :
+    return -EINVAL;
+  }
 
   return 0;
 }
 
+static ssize_t rpi_gpio_ioctl_nrt(struct rtdm_dev_context* context, rtdm_user_info_t* user_info, unsigned int request, void __user* arg)
+{
+  struct rpi_gpio_context *ctx = (struct rpi_gpio_context *) context->dev_private;
+
+  if (request == RPI_GPIO_BIND)
+    return rpi_gpio_bind(ctx, (unsigned long)arg);
+  if (request == RPI_GPIO_CONFIG)
+    return rpi_gpio_config(ctx, user_info, arg);
+
+  return rpi_gpio_ioctl_rt(context, user_info, request, arg);
+}
+
 static struct rtdm_device device = {
  struct_version:         RTDM_DEVICE_STRUCT_VER,
  
@@ -82,12 +675,12 @@ static struct rtdm_device device = {
   close_nrt:      rpi_gpio_close,
   
   ioctl_rt:       rpi_gpio_ioctl_rt,
-  ioctl_nrt:      NULL,
+  ioctl_nrt:      rpi_gpio_ioctl_nrt,
   
   read_rt:        NULL,
   read_nrt:       NULL,
 
-  write_rt:       NULL,
+  write_rt:       rpi_gpio_write_rt,
   write_nrt:      NULL,   
   },
 
@@ -103,8 +696,13 @@ static struct rtdm_device device = {
 
 int __init rpi_gpio_init(void)
 {
+  int i;
+
   rtdm_printk("RPI_GPIO RTDM, loading\n");
 
+  rtdm_lock_init(&fsel_lock);
+
+
   // Map GPIO addr
   if ((virt_addr = ioremap (GPIO_BASE, PAGE_SIZE)) == NULL) {
     printk(KERN_ERR "Can't map GPIO addr !\n");
@@ -113,6 +711,10 @@ int __init rpi_gpio_init(void)
   else
     printk(KERN_INFO "GPIO mapped to 0x%08x\n", (unsigned int)virt_addr);
 
+  // the only GPFSEL reads
+  for (i = 0; i < RPI_GPIO_FSEL_WORDS; i++)
+    fsel_shadow[i] = GPIO_FSEL(virt_addr, i);
+
   return rtdm_dev_register (&device); 
 }
 
@@ -0,0 +1,142 @@
+/*
+ * GPIO RTDM driver example for Raspberry Pi, ioctl requests
+ */
+#ifndef __RPI_GPIO_RTDM_H
+#define __RPI_GPIO_RTDM_H
+
+#ifdef __KERNEL__
+#include <linux/ioctl.h>
+#include <linux/types.h>
+#else
+#include <sys/ioctl.h>
+#include <stdint.h>
+#endif
+
+// Historical requests: set or clear the pin(s) of the fd, the module
+// gpio_nr until the fd is bound
+#define RPI_GPIO_SET          0
+#define RPI_GPIO_CLR          1
+
+#define RPI_GPIO_RTIOC_TYPE   'g'
+
+// arg is a GPIO 0-31 pin mask (not a pointer). The pins are claimed
+// for this fd only and set as outputs, RPI_GPIO_BIND fails with EBUSY
+// if one of them is bound to another fd or is the module gpio_nr
+// (driven by the unbound fds). 0 releases the pins, so does close().
+// Non-RT request.
+#define RPI_GPIO_BIND         _IO(RPI_GPIO_RTIOC_TYPE, 0)
+
+// arg is a pin mask, pins outside the bound set are ignored
+#define RPI_GPIO_SET_PINS     _IO(RPI_GPIO_RTIOC_TYPE, 1)
+#define RPI_GPIO_CLR_PINS     _IO(RPI_GPIO_RTIOC_TYPE, 2)
+
+// Timed commands, see write()
+#define RPI_GPIO_QUEUE_STATS  _IOR(RPI_GPIO_RTIOC_TYPE, 3, struct rpi_gpio_queue_stats)
+#define RPI_GPIO_QUEUE_FLUSH  _IO(RPI_GPIO_RTIOC_TYPE, 4)   // drop pending commands
+
+// Pulses, see struct rpi_gpio_pulse
+#define RPI_GPIO_PULSE        _IOW(RPI_GPIO_RTIOC_TYPE, 5, struct rpi_gpio_pulse)
+#define RPI_GPIO_PULSE_INFO   _IOR(RPI_GPIO_RTIOC_TYPE, 6, struct rpi_gpio_pulse_info)
+
+// Output latch, see struct rpi_gpio_latch
+#define RPI_GPIO_LATCH        _IOW(RPI_GPIO_RTIOC_TYPE, 7, struct rpi_gpio_latch)
+#define RPI_GPIO_COMMIT       _IO(RPI_GPIO_RTIOC_TYPE, 8)
+#define RPI_GPIO_LATCH_STATS  _IOR(RPI_GPIO_RTIOC_TYPE, 9, struct rpi_gpio_latch_stats)
+
+// Pin functions, see struct rpi_gpio_config
+#define RPI_GPIO_CONFIG       _IOW(RPI_GPIO_RTIOC_TYPE, 10, struct rpi_gpio_config)
+
+#define RPI_GPIO_QUEUE_LEN    64    // commands per fd, power of 2
+
+// write() takes an array of commands, run from a driver timer at their
+// time: GPSET0 = set, then GPCLR0 = clr, both limited to the pins of
+// the fd (~0 means all of them). Times are CLOCK_MONOTONIC ns and must
+// not go backwards, a time already past runs at once. write() blocks
+// while the queue is full unless the fd was opened with O_NONBLOCK,
+// RT request.
+struct rpi_gpio_cmd {
+  uint64_t time;
+  uint32_t set;
+  uint32_t clr;
+};
+
+struct rpi_gpio_queue_stats {
+  uint32_t queued;      // commands accepted by write()
+  uint32_t done;        // commands run
+  uint32_t past;        // time already past when written
+  uint32_t pending;
+  uint32_t max_latency; // ns, command time to GPIO store
+  uint32_t avg_latency;
+};
+
+// RPI_GPIO_PULSE: set the pins (limited to those of the fd, ~0 means
+// all of them) at once, clear them width ns later and return without
+// waiting. The end is reached by a timer armed margin ns before it
+// then by a busy-wait on the RTDM monotonic clock, pulses shorter than
+// the margin are all busy-wait. EBUSY while the previous pulse of the
+// fd is not over. RT request.
+struct rpi_gpio_pulse {
+  uint32_t mask;
+  uint32_t width;       // ns
+};
+
+// RPI_GPIO_PULSE_INFO: margin and achieved widths of the fd
+struct rpi_gpio_pulse_info {
+  uint32_t margin;         // ns, pulse_margin, at most 50 us
+  uint32_t count;
+  uint32_t late;           // timer fired after the end of the pulse
+  uint32_t last_width;     // ns, achieved
+  uint32_t max_error;      // ns, achieved - requested
+  uint32_t avg_error;
+};
+
+// RPI_GPIO_LATCH: with RPI_GPIO_LATCH_MANUAL or _AUTO, the set and clear
+// requests of the fd only update a shadow latch, the net change is
+// written by RPI_GPIO_COMMIT (one GPSET0 and one GPCLR0 store at most,
+// none for an empty side). _AUTO also commits from a driver timer every
+// period ns from start (CLOCK_REALTIME ns, the clock of
+// pthread_make_periodic_np()), requests made during a period show up
+// together at the next boundary. _OFF commits what is pending and goes
+// back to immediate stores. Pulses and timed commands are not latched.
+// RT request.
+#define RPI_GPIO_LATCH_OFF     0
+#define RPI_GPIO_LATCH_MANUAL  1
+#define RPI_GPIO_LATCH_AUTO    2
+
+struct rpi_gpio_latch {
+  uint32_t mode;
+  uint32_t period;      // ns, _AUTO only
+  uint64_t start;
+};
+
+struct rpi_gpio_latch_stats {
+  uint32_t requests;    // set/clear requests latched
+  uint32_t commits;
+  uint32_t stores;      // GPSET0/GPCLR0 writes
+};
+
+// RPI_GPIO_CONFIG: func[n] is the new function of GPIO n for every n in
+// mask (GPIO 0-53), the other pins keep theirs. The driver keeps a copy
+// of GPFSEL0-5 read at load time, the six words are built from it in
+// one pass and only those that change are stored, GPFSEL is never read
+// back (open and RPI_GPIO_BIND go through it too). EBUSY if one of
+// GPIO 0-31 is bound to another fd. Returns the GPFSEL stores done.
+// Non-RT request.
+#define RPI_GPIO_FSEL_IN      0
+#define RPI_GPIO_FSEL_OUT     1
+#define RPI_GPIO_FSEL_ALT0    4
+#define RPI_GPIO_FSEL_ALT1    5
+#define RPI_GPIO_FSEL_ALT2    6
+#define RPI_GPIO_FSEL_ALT3    7
+#define RPI_GPIO_FSEL_ALT4    3
+#define RPI_GPIO_FSEL_ALT5    2
+
+#define RPI_GPIO_FSEL_PINS    54    // 10 per GPFSEL word
+#define RPI_GPIO_FSEL_WORDS   6
+
+struct rpi_gpio_config {
+  uint64_t mask;
+  uint8_t func[RPI_GPIO_FSEL_PINS];
+};
+
+#endif
@@ -16,12 +16,18 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <rtdk.h>
+#include "rpi_gpio_rtdm.h"
 
 pthread_t thid_square;
 
 #define PERIOD          50000000 // 50 ms
 
+#define QUEUE_BATCH     16       // edges planned per write()
+
 unsigned long period_ns = 0;
+int queue_mode = 0;
+unsigned long pulse_ns = 0;     /* pulse mode, width */
+int latch_mode = 0;
 int loop_prt = 100;             /* print every 100 loops: 5 s */ 
 unsigned int test_loops = 0;    /* outer loop count */
 int fd;
@@ -31,6 +37,10 @@ void *thread_square (void *dummy)
 {
   int err, cmd;
   struct timespec start, period, t, told;
+  struct rpi_gpio_pulse pulse;
+  struct rpi_gpio_pulse_info pi;
+  struct rpi_gpio_latch latch;
+  struct rpi_gpio_latch_stats ls;
 
   /* Start a periodic task in 1s */
   clock_gettime(CLOCK_REALTIME, &start);
@@ -47,6 +57,18 @@ void *thread_square (void *dummy)
       exit(EXIT_FAILURE);
     }
 
+  // Latched outputs, committed by the driver half a period after each
+  // wake-up, whatever the time the loop body takes
+  if (latch_mode) {
+    latch.mode = RPI_GPIO_LATCH_AUTO;
+    latch.period = period_ns;
+    latch.start = start.tv_sec * 1000000000ULL + start.tv_nsec + period_ns / 2;
+    if ((err = rt_dev_ioctl(fd, RPI_GPIO_LATCH, &latch)) < 0) {
+      fprintf(stderr,"square: failed to set latch, code %d\n",err);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   /* Main loop */
   for (;;)
     {
@@ -63,9 +85,17 @@ void *thread_square (void *dummy)
       }
 
       /* Write to GPIO */
-      cmd = (test_loops % 2 ? 0 : 1);
-	  
-      if (rt_dev_ioctl(fd, cmd, 0) < 0) {
+      if (pulse_ns) {
+	pulse.mask = ~0;
+	pulse.width = pulse_ns;
+	err = rt_dev_ioctl(fd, RPI_GPIO_PULSE, &pulse);
+      }
+      else {
+	cmd = (test_loops % 2 ? RPI_GPIO_SET : RPI_GPIO_CLR);
+	err = rt_dev_ioctl(fd, cmd, 0);
+      }
+
+      if (err < 0) {
 	perror ("rt_dev_ioctl");
 	exit (1);
       }
@@ -80,6 +110,52 @@ void *thread_square (void *dummy)
       /* Print if necessary */
       if ((test_loops % loop_prt) == 0)
 	rt_printf ("Loop= %d dt= %d %d (%d ns)\n", test_loops, t.tv_sec - told.tv_sec, t.tv_nsec - told.tv_nsec, t.tv_nsec - told.tv_nsec - period_ns);
+
+      if (pulse_ns && (test_loops % loop_prt) == 0 && rt_dev_ioctl(fd, RPI_GPIO_PULSE_INFO, &pi) == 0)
+	rt_printf ("Pulses= %u width= %u ns error avg= %u max= %u ns late= %u (margin %u ns)\n",
+		   pi.count, pi.last_width, pi.avg_error, pi.max_error, pi.late, pi.margin);
+
+      if (latch_mode && (test_loops % loop_prt) == 0 && rt_dev_ioctl(fd, RPI_GPIO_LATCH_STATS, &ls) == 0)
+	rt_printf ("Latch requests= %u commits= %u stores= %u\n", ls.requests, ls.commits, ls.stores);
+    }
+}
+
+/*
+ * Queue mode: the edges are planned ahead and run by the driver timer,
+ * the thread only wakes up to refill the queue (write() blocks while
+ * it is full)
+ */
+void *thread_queue (void *dummy)
+{
+  struct rpi_gpio_cmd cmd[QUEUE_BATCH];
+  struct rpi_gpio_queue_stats st;
+  struct timespec now;
+  unsigned long long t;
+  int i;
+
+  /* First edge in 1s */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  t = (now.tv_sec + 1) * 1000000000ULL + now.tv_nsec;
+
+  for (;;)
+    {
+      for (i = 0; i < QUEUE_BATCH; i++) {
+	test_loops++;
+	cmd[i].time = t;
+	cmd[i].set = (test_loops % 2 ? ~0 : 0);  // all the pins of the fd
+	cmd[i].clr = ~cmd[i].set;
+	t += period_ns;
+      }
+
+      if (rt_dev_write(fd, cmd, sizeof(cmd)) < 0) {
+	perror ("rt_dev_write");
+	exit (1);
+      }
+
+      /* Print if necessary */
+      if ((test_loops % loop_prt) < QUEUE_BATCH && rt_dev_ioctl(fd, RPI_GPIO_QUEUE_STATS, &st) == 0)
+	rt_printf ("Loop= %d queued= %u done= %u pending= %u late= %u latency avg= %u max= %u ns\n",
+		   test_loops, st.queued, st.done, st.pending, st.past, st.avg_latency, st.max_latency);
     }
 }
 
@@ -93,13 +169,13 @@ void cleanup_upon_sig(int sig __attribute__((unused)))
 
 void usage (char *s)
 {
-  fprintf (stderr, "Usage: %s [-p period (ns)] [-r rtdm_driver_name]\n", s);
+  fprintf (stderr, "Usage: %s [-p period (ns)] [-r rtdm_driver_name] [-g gpio] [-q] [-w pulse width (ns)] [-l]\n", s);
   exit (1);
 }
 
 int main (int ac, char **av)
 {
-  int err;
+  int err, gpio = -1;
   char *cp, *progname = (char*)basename(av[0]), *rtdm_driver;
   struct sched_param param_square = {.sched_priority = 99 };
   pthread_attr_t thattr_square;
@@ -123,6 +199,24 @@ int main (int ac, char **av)
 	rtdm_driver = *++av;
 	break;
 
+      case 'g' :
+	gpio = atoi(*++av);
+	if (gpio < 0 || gpio >= 32)
+	  usage(progname);
+	break;
+
+      case 'q' :
+	queue_mode = 1;
+	break;
+
+      case 'w' :
+	pulse_ns = (unsigned long)atoi(*++av);
+	break;
+
+      case 'l' :
+	latch_mode = 1;
+	break;
+
       default: 
 	usage(progname);
 	break;
@@ -149,6 +243,12 @@ int main (int ac, char **av)
     exit(EXIT_FAILURE);
   }
 
+  // Own pin for this instance, several instances can share the driver
+  if (gpio >= 0 && rt_dev_ioctl(fd, RPI_GPIO_BIND, 1 << gpio) < 0) {
+    perror("rt_dev_ioctl(RPI_GPIO_BIND)");
+    exit(EXIT_FAILURE);
+  }
+
   // Thread attributes
   pthread_attr_init(&thattr_square);
 
@@ -161,7 +261,7 @@ int main (int ac, char **av)
   pthread_attr_setschedparam(&thattr_square, &param_square);
 
   // Create thread 
-  err = pthread_create(&thid_square, &thattr_square, &thread_square, NULL);
+  err = pthread_create(&thid_square, &thattr_square, queue_mode ? &thread_queue : &thread_square, NULL);
 
   if (err)
     {
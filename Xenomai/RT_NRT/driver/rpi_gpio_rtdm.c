@@ -15,11 +15,7 @@ MODULE_AUTHOR("Pierre Ficheux");
 #define BCM2708_PERI_BASE        0x20000000
 #define GPIO_BASE                (BCM2708_PERI_BASE + 0x200000) /* GPIO controler */
 
-// GPIO setup macros. Always use INP_GPIO(x) before using OUT_GPIO(x) 
-// or SET_GPIO_ALT(x,y)
-#define INP_GPIO(addr,g) *((addr)+((g)/10)) &= ~(7<<(((g)%10)*3))
-#define OUT_GPIO(addr,g) *((addr)+((g)/10)) |=  (1<<(((g)%10)*3))
-
+#define GPIO_FSEL(gpio,k) *((gpio)+(k)) // GPFSEL0-5, only written, see fsel_shadow
 #define GPIO_SET(gpio) *((gpio)+7)  // sets   bits which are 1 ignores bits which are 0
 #define GPIO_CLR(gpio) *((gpio)+10) // clears bits which are 1 ignores bits which are 0
 
@@ -35,6 +31,31 @@ module_param(debug, int, 0644);
 module_param(gpio_rt, int, 0644);
 module_param(gpio_nrt, int, 0644);
 
+// Copy of GPFSEL0-3 (GPIO 0-31) read at load time, open() builds the
+// words from it and only stores those that change
+static rtdm_lock_t fsel_lock;
+static uint32_t fsel_shadow[4];
+
+static void pins_output(unsigned long *addr, unsigned long mask)
+{
+  rtdm_lockctx_t lock_ctx;
+  uint32_t w;
+  int k, shift, g;
+
+  rtdm_lock_get_irqsave(&fsel_lock, lock_ctx);
+  for (k = 0, g = 0; k < 4; k++) {
+    w = fsel_shadow[k];
+    for (shift = 0; shift < 30 && g < 32; shift += 3, g++)
+      if (mask & (1UL << g))
+	w = (w & ~(7 << shift)) | (1 << shift);
+    if (w != fsel_shadow[k]) {
+      fsel_shadow[k] = w;
+      GPIO_FSEL(addr, k) = w;
+    }
+  }
+  rtdm_lock_put_irqrestore(&fsel_lock, lock_ctx);
+}
+
 struct rpi_gpio_context {
   unsigned long *gpio_addr;
   int gpio_rt;
@@ -50,9 +71,8 @@ int rpi_gpio_open(struct rtdm_dev_context *context, rtdm_user_info_t *user_info,
   ctx->gpio_rt = gpio_rt;
   ctx->gpio_nrt = gpio_nrt;
 
-
-  OUT_GPIO(ctx->gpio_addr, ctx->gpio_rt);
-  OUT_GPIO(ctx->gpio_addr, ctx->gpio_nrt);
+  // both pins at once, no store after the first open
+  pins_output(ctx->gpio_addr, (1UL << ctx->gpio_rt) | (1UL << ctx->gpio_nrt));
 
   return 0;
 }
@@ -126,6 +146,8 @@ static struct rtdm_device device = {
 
 int __init rpi_gpio_init(void)
 {
+  int i;
+
   rtdm_printk("RPI_GPIO RTDM, loading\n");
 
   // Map GPIO addr
@@ -136,6 +158,10 @@ int __init rpi_gpio_init(void)
   else
     printk(KERN_INFO "GPIO mapped to 0x%08x\n", (unsigned int)virt_addr);
 
+  rtdm_lock_init(&fsel_lock);
+  for (i = 0; i < 4; i++)
+    fsel_shadow[i] = GPIO_FSEL(virt_addr, i);
+
   return rtdm_dev_register (&device); 
 }
 
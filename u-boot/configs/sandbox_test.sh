@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Run boot_script_mmc.txt in the u-boot sandbox, the SD card being a
+# FAT image bound to host 0
+#
+# usage: sandbox_test.sh u-boot_build_dir
+# (sandbox_defconfig + rpi_fastboot.config, needs mkimage, dtc, mkfs.vfat, mcopy)
+#
+set -e
+
+UB=${1:?usage: $0 u-boot_build_dir}
+HERE=$(cd $(dirname $0) && pwd)
+TMP=$(mktemp -d)
+trap "rm -rf $TMP" EXIT
+
+# Dummy payloads, only loaded and hash checked
+cd $TMP
+dd if=/dev/urandom of=zImage bs=1k count=512 2>/dev/null
+dd if=/dev/urandom of=initramfs.cpio.gz bs=1k count=256 2>/dev/null
+echo '/dts-v1/; / { };' | dtc -O dtb -o bcm2708-rpi-b.dtb
+cp $HERE/rpi.its $HERE/uEnv_mmc.txt .
+mkimage -f rpi.its rpi.itb >/dev/null
+mkimage -A arm -O linux -T script -C none -n "RPi MMC boot" -d $HERE/boot_script_mmc.txt boot.scr >/dev/null
+
+mkfs.vfat -C sd.img 8192 >/dev/null
+mcopy -i sd.img rpi.itb boot.scr uEnv_mmc.txt ::
+
+$UB/u-boot -d $UB/u-boot.dtb -c "
+host bind 0 $TMP/sd.img;
+load host 0 0x00200000 uEnv_mmc.txt && env import -t 0x00200000 \${filesize};
+setenv boot_iface host; setenv boot_dev 0; setenv fit_test 1;
+load host 0 0x00300000 boot.scr && source 0x00300000" | tee u-boot.log
+
+# iminfo output, one line per image of rpi.its, "crc32-" on a mismatch
+grep -q "Hash(es) for Image 0 (kernel): crc32+" u-boot.log
+grep -q "Hash(es) for Image 1 (fdt-rpi): crc32+" u-boot.log
+grep -q "Hash(es) for Image 2 (ramdisk): crc32+" u-boot.log
+if grep -q "crc32-" u-boot.log; then
+  echo "sandbox boot: bad hash"
+  exit 1
+fi
+grep -q "Timer summary in microseconds" u-boot.log
+echo "sandbox boot: OK"